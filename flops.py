@@ -2,15 +2,20 @@ import numpy as np
 import pandas as pd
 import matplotlib.pyplot as plt
 
+from results import load_results
+
 n = input("Enter the value of n to plot: ")
-data = pd.read_csv("results/results_mpi.csv")
+data = load_results()
+
+# Hybrid runs are compared by the number of cores they use
+data["processes"] = data["processes"] * data["threads"]
 
 data = data.sort_values(["code", "n"])
 
 filter = pow(2, int(n))
 data = data[data["n"] == filter]
 
-custom_code_order = ["S", "M", "MD", "MC"]
+custom_code_order = ["S", "SR", "SO", "M", "MD", "MC", "MA", "MH", "MS", "MG", "MP", "MR", "MM"]
 xticks_values = [1, 2, 4, 8, 16]
 color_map = {code: plt.cm.tab10(i) for i, code in enumerate(data["code"].unique())}
 
@@ -24,7 +29,7 @@ for code in custom_code_order:
         code_data = data[data["code"] == code]
         color = color_map[code]
 
-        if code == "S":
+        if code in ["S", "SR"]:
             ax.axhline(
                 y=code_data["flops"].values[0],
                 color=color,
@@ -0,0 +1,198 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <linux/mempolicy.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ALLOC_ALIGNMENT 64            // cache line, and a full AVX-512 register
+#define ALLOC_HUGE_PAGE (2 << 20)     // huge pages of x86-64
+#define ALLOC_POOL 16                 // freed buffers kept for reuse
+#define ALLOC_POOL_BYTES (256 << 20)  // bytes of the mappings kept for reuse, larger buffers are unmapped when freed
+#define ALLOC_NODES_FILE "/sys/devices/system/node/online"
+
+typedef enum { HUGE_NONE, HUGE_TRANSPARENT, HUGE_EXPLICIT } HugePages;
+typedef enum { NUMA_DEFAULT, NUMA_LOCAL, NUMA_INTERLEAVE } NumaPlacement;
+
+// Placement of the matrix buffers, set once from the options: hugepages (transparent, through madvise) or
+// hugepages=explicit (MAP_HUGETLB, from the pages reserved in /proc/sys/vm/nr_hugepages), numa=local or
+// numa=interleave (mbind over the online nodes). With none of them the pages go where the first touch puts them.
+typedef struct {
+    HugePages huge;
+    NumaPlacement numa;
+    void* pool[ALLOC_POOL];  // freed buffers, reused by the next allocations that fit
+    size_t pooled;           // bytes of their mappings
+} Allocator;
+
+// Header stored in the first line of every mapping, the buffer starts right after it so it keeps the alignment
+typedef struct {
+    void* base;
+    size_t length;    // of the whole mapping
+    size_t capacity;  // bytes available to the buffer
+    HugePages huge;
+    NumaPlacement numa;
+} AllocHeader;
+
+static Allocator allocator = {.huge = HUGE_NONE, .numa = NUMA_DEFAULT, .pooled = 0};
+
+static inline void allocatorInit(int argc, char** argv) {
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "hugepages") == 0) allocator.huge = HUGE_TRANSPARENT;
+        if (strcmp(argv[i], "hugepages=explicit") == 0) allocator.huge = HUGE_EXPLICIT;
+        if (strcmp(argv[i], "numa=local") == 0) allocator.numa = NUMA_LOCAL;
+        if (strcmp(argv[i], "numa=interleave") == 0) allocator.numa = NUMA_INTERLEAVE;
+    }
+}
+
+// Mask of the online NUMA nodes, from ranges as "0-3,5"; node 0 only if the file is missing
+static inline unsigned long onlineNodes() {
+    unsigned long mask = 0;
+    char line[256];
+    FILE* f = fopen(ALLOC_NODES_FILE, "r");
+
+    if (f == NULL || fgets(line, sizeof(line), f) == NULL) {
+        if (f != NULL) fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    for (char* range = strtok(line, ",\n"); range != NULL; range = strtok(NULL, ",\n")) {
+        int first, last;
+        int fields = sscanf(range, "%d-%d", &first, &last);
+        if (fields < 1) continue;
+        if (fields == 1) last = first;
+        for (int node = first; node <= last && node < 64; node++) mask |= 1UL << node;
+    }
+
+    return mask != 0 ? mask : 1;
+}
+
+static inline void bindNodes(void* base, size_t length, NumaPlacement numa) {
+    unsigned long mask = onlineNodes();
+    long result = numa == NUMA_INTERLEAVE ? syscall(__NR_mbind, base, length, MPOL_INTERLEAVE, &mask, 8 * sizeof(mask) + 1, 0)
+                                          : syscall(__NR_mbind, base, length, MPOL_PREFERRED, NULL, 0, 0);  // empty: local node
+
+    if (result != 0) printf("Warning: NUMA placement not applied, the buffer is placed by first touch\n");
+}
+
+// New mapping of at least bytes after the header. Explicit huge pages fall back to transparent ones when none are
+// reserved; transparent ones are requested on a range aligned to the huge page, which the kernel can back entirely.
+static inline void* allocMapping(size_t bytes) {
+    size_t length = ALLOC_ALIGNMENT + bytes;
+    size_t extra = allocator.huge == HUGE_NONE ? 0 : ALLOC_HUGE_PAGE;
+    HugePages huge = allocator.huge;
+    char* base = MAP_FAILED;
+    char* start;
+
+    if (huge == HUGE_EXPLICIT) {
+        length = (length + ALLOC_HUGE_PAGE - 1) / ALLOC_HUGE_PAGE * ALLOC_HUGE_PAGE;
+        base = (char*)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) {
+            printf("Warning: no explicit huge pages available, using transparent huge pages\n");
+            allocator.huge = huge = HUGE_TRANSPARENT;
+        }
+    }
+
+    if (base == MAP_FAILED) {
+        length += extra;
+        base = (char*)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) return NULL;
+    }
+
+    start = huge == HUGE_TRANSPARENT ? (char*)(((uintptr_t)base + ALLOC_HUGE_PAGE - 1) & ~(uintptr_t)(ALLOC_HUGE_PAGE - 1)) : base;
+    if (huge == HUGE_TRANSPARENT) madvise(start, length - (start - base), MADV_HUGEPAGE);
+    if (allocator.numa != NUMA_DEFAULT) bindNodes(base, length, allocator.numa);
+
+    AllocHeader* header = (AllocHeader*)start;
+    header->base = base;
+    header->length = length;
+    header->capacity = length - (start - base) - ALLOC_ALIGNMENT;
+    header->huge = huge;
+    header->numa = allocator.numa;
+
+    return start + ALLOC_ALIGNMENT;
+}
+
+static inline AllocHeader* allocHeader(void* buffer) {
+    return (AllocHeader*)((char*)buffer - ALLOC_ALIGNMENT);
+}
+
+// Buffer of bytes aligned to ALLOC_ALIGNMENT with the current placement, the smallest freed one that fits if any
+static inline void* allocBuffer(size_t bytes) {
+    int best = -1;
+
+    for (int k = 0; k < ALLOC_POOL; k++) {
+        AllocHeader* header = allocator.pool[k] != NULL ? allocHeader(allocator.pool[k]) : NULL;
+        if (header == NULL || header->capacity < bytes || header->huge != allocator.huge || header->numa != allocator.numa) continue;
+        if (best == -1 || header->capacity < allocHeader(allocator.pool[best])->capacity) best = k;
+    }
+
+    if (best != -1) {
+        void* buffer = allocator.pool[best];
+        allocator.pool[best] = NULL;
+        allocator.pooled -= allocHeader(buffer)->length;
+        return buffer;
+    }
+
+    return allocMapping(bytes);
+}
+
+static inline void releaseBuffer(void* buffer) {
+    AllocHeader* header = allocHeader(buffer);
+    munmap(header->base, header->length);
+}
+
+// Returns the buffer to the pool, where it stays mapped (and its pages placed) for the next allocation. The pool holds
+// up to ALLOC_POOL buffers and ALLOC_POOL_BYTES: larger buffers are unmapped at once, and the smallest pooled ones are
+// unmapped to make room for a larger one.
+static inline void freeBuffer(void* buffer) {
+    if (buffer == NULL) return;
+
+    size_t length = allocHeader(buffer)->length;
+    if (length > ALLOC_POOL_BYTES) {
+        releaseBuffer(buffer);
+        return;
+    }
+
+    for (;;) {
+        int empty = -1, smallest = -1;
+        for (int k = 0; k < ALLOC_POOL; k++) {
+            if (allocator.pool[k] == NULL) {
+                if (empty == -1) empty = k;
+            } else if (smallest == -1 || allocHeader(allocator.pool[k])->length < allocHeader(allocator.pool[smallest])->length) {
+                smallest = k;
+            }
+        }
+
+        if (empty != -1 && allocator.pooled + length <= ALLOC_POOL_BYTES) {
+            allocator.pool[empty] = buffer;
+            allocator.pooled += length;
+            return;
+        }
+        if (allocHeader(allocator.pool[smallest])->length >= length) {
+            releaseBuffer(buffer);
+            return;
+        }
+
+        allocator.pooled -= allocHeader(allocator.pool[smallest])->length;
+        releaseBuffer(allocator.pool[smallest]);
+        allocator.pool[smallest] = NULL;
+    }
+}
+
+// Unmaps the pooled buffers, at exit
+static inline void allocatorRelease() {
+    for (int k = 0; k < ALLOC_POOL; k++) {
+        if (allocator.pool[k] != NULL) releaseBuffer(allocator.pool[k]);
+        allocator.pool[k] = NULL;
+    }
+    allocator.pooled = 0;
+}
+
+#endif
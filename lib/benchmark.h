@@ -0,0 +1,127 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WARMUP 1                // default untimed runs before the repetitions
+#define FLUSH_BYTES (64 << 20)  // written between the repetitions, larger than the last level caches
+#define CACHE_LINE 64
+
+// Compiler barriers in place of -O0 on the repetition loops: the value is treated as read by the asm statement and
+// all the memory as read and written, so the kernels of the loops are neither hoisted nor removed at -O3
+#define doNotOptimize(value) __asm__ volatile("" : : "r,m"(value) : "memory")
+#define clobberMemory() __asm__ volatile("" : : : "memory")
+
+// Driver of the repetition loops: warm-up runs, then every repetition timed on its own
+typedef struct {
+    int warmup;       // warmup=<runs>
+    bool flush;       // flush: caches flushed before every repetition, which then starts cold
+    int rep;
+    double* samples;  // seconds of each repetition
+    char* flush_buffer;
+    struct timespec start;
+} Benchmark;
+
+typedef struct {
+    double mean, median, p95, min, stddev;
+} BenchmarkStats;
+
+static inline Benchmark benchmarkInit(int argc, char** argv, int rep) {
+    Benchmark bench = {.warmup = WARMUP, .flush = false, .rep = rep, .samples = NULL, .flush_buffer = NULL};
+
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], "warmup=", 7) == 0 && atoi(argv[i] + 7) >= 0) bench.warmup = atoi(argv[i] + 7);
+        if (strcmp(argv[i], "flush") == 0) bench.flush = true;
+    }
+
+    bench.samples = (double*)calloc(rep, sizeof(double));
+    if (bench.flush) bench.flush_buffer = (char*)calloc(FLUSH_BYTES, 1);
+
+    return bench;
+}
+
+static inline void benchmarkFree(Benchmark* bench) {
+    free(bench->samples);
+    free(bench->flush_buffer);
+}
+
+// Evicts the working set of the kernels by touching a buffer larger than the caches, one line at a time
+static inline void benchmarkFlush(Benchmark* bench) {
+    for (size_t i = 0; i < FLUSH_BYTES; i += CACHE_LINE) bench->flush_buffer[i]++;
+    doNotOptimize(bench->flush_buffer);
+}
+
+static inline void benchmarkStart(Benchmark* bench) {
+    if (bench->flush_buffer != NULL) benchmarkFlush(bench);
+    clobberMemory();
+    clock_gettime(CLOCK_MONOTONIC, &bench->start);
+}
+
+static inline void benchmarkStop(Benchmark* bench, int repetition) {
+    struct timespec end;
+
+    clobberMemory();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    bench->samples[repetition] = (end.tv_sec - bench->start.tv_sec) + (end.tv_nsec - bench->start.tv_nsec) * 1e-9;
+}
+
+static inline int compareSamples(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Statistics of the samples, sorted in place; the 95th percentile is the nearest rank
+static inline BenchmarkStats benchmarkStats(Benchmark* bench) {
+    BenchmarkStats stats = {NAN, NAN, NAN, NAN, NAN};
+    int count = bench->rep;
+    double* samples = bench->samples;
+
+    if (count <= 0) return stats;
+
+    qsort(samples, count, sizeof(double), compareSamples);
+
+    double sum = 0, squares = 0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    stats.mean = sum / count;
+    for (int i = 0; i < count; i++) squares += (samples[i] - stats.mean) * (samples[i] - stats.mean);
+
+    stats.median = count % 2 == 1 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    stats.p95 = samples[(int)ceil(0.95 * count) - 1];
+    stats.min = samples[0];
+    stats.stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+
+    return stats;
+}
+
+// Statistics of a repetition of many operations (e.g. a batch of matrices) rescaled to one operation
+static inline void benchmarkScaleStats(BenchmarkStats* stats, double factor) {
+    stats->mean *= factor;
+    stats->median *= factor;
+    stats->p95 *= factor;
+    stats->min *= factor;
+    stats->stddev *= factor;
+}
+
+static inline void printBenchmarkStats(const BenchmarkStats* stats) {
+    printf("\t\t median %.9f\tp95 %.9f\tmin %.9f\tstddev %.9f seconds\n", stats->median, stats->p95, stats->min, stats->stddev);
+}
+
+#ifdef MPI_VERSION
+// A repetition lasts as long as its slowest process: the samples are reduced by maximum, the statistics are significant
+// on rank 0 only
+static inline BenchmarkStats benchmarkStatsMPI(Benchmark* bench, MPI_Comm comm) {
+    int rank;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : bench->samples, bench->samples, bench->rep, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    return benchmarkStats(bench);
+}
+#endif
+
+#endif
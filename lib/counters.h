@@ -0,0 +1,168 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <linux/perf_event.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define COUNTER_EVENTS 4
+#define COUNTER_LINE 64  // bytes moved by a last level cache miss
+
+// Hardware counters of the calling thread and of the threads it creates afterwards (the OpenMP threads, when opened
+// before the first parallel region), counted in user space only and enabled around the kernel regions (the effective
+// times) by countersStart/countersStop; with no counters option, or where the events cannot be opened (e.g. virtual
+// machines with no PMU), every call is a no-op and the values are nan
+typedef struct {
+    bool enabled;
+    int fds[COUNTER_EVENTS];
+    uint64_t base[COUNTER_EVENTS][3];  // value, time enabled and time running at the start of the phase
+    struct timespec start;             // of the current kernel region
+    double seconds;                    // wall time of the kernel regions of the phase
+} Counters;
+
+// Values of a phase per repetition, memory bandwidth estimated from the last level cache misses over the time counted
+typedef struct {
+    double cycles, instructions, llc_misses, dtlb_misses, bandwidth;
+} CounterValues;
+
+static Counters counters = {.enabled = false, .fds = {-1, -1, -1, -1}, .seconds = 0};
+
+// Opens the events when the counters option is passed, with a warning (if verbose) for the ones not available
+static inline int countersInit(int argc, char** argv, bool verbose) {
+    const uint32_t types[COUNTER_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+    const uint64_t configs[COUNTER_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+    const char* names[COUNTER_EVENTS] = {"cycles", "instructions", "LLC misses", "dTLB misses"};
+    int opened = 0;
+    bool enabled = false;
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "counters") == 0) enabled = true;
+    }
+    if (!enabled) return 0;
+
+    for (int e = 0; e < COUNTER_EVENTS; e++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[e];
+        attr.config = configs[e];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;  // the reads sum the threads created after the open
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;  // to scale multiplexed events
+
+        counters.fds[e] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters.fds[e] >= 0) {
+            opened++;
+        } else if (verbose) {
+            printf("Warning: %s counter not available, saved as nan\n", names[e]);
+        }
+    }
+
+    counters.enabled = opened > 0;
+    memset(counters.base, 0, sizeof(counters.base));
+    counters.seconds = 0;
+
+    return opened;
+}
+
+static inline void countersClose() {
+    for (int e = 0; e < COUNTER_EVENTS; e++) {
+        if (counters.fds[e] >= 0) close(counters.fds[e]);
+        counters.fds[e] = -1;
+    }
+    counters.enabled = false;
+}
+
+static inline void countersStart() {
+    if (!counters.enabled) return;
+    for (int e = 0; e < COUNTER_EVENTS; e++) {
+        if (counters.fds[e] >= 0) ioctl(counters.fds[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &counters.start);
+}
+
+static inline void countersStop() {
+    struct timespec end;
+
+    if (!counters.enabled) return;
+    for (int e = 0; e < COUNTER_EVENTS; e++) {
+        if (counters.fds[e] >= 0) ioctl(counters.fds[e], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    counters.seconds += (end.tv_sec - counters.start.tv_sec) + (end.tv_nsec - counters.start.tv_nsec) * 1e-9;
+}
+
+// Counts since the start of the phase, scaled by the fraction of time the event was on the PMU; nan if not opened
+static inline double countersDelta(int e, uint64_t current[3]) {
+    if (counters.fds[e] < 0 || read(counters.fds[e], current, 3 * sizeof(uint64_t)) != 3 * sizeof(uint64_t)) return NAN;
+
+    double value = current[0] - counters.base[e][0];
+    double running = current[2] - counters.base[e][2];
+    double enabled = current[1] - counters.base[e][1];
+
+    return running > 0 ? value * enabled / running : 0;
+}
+
+// Values of the phase since the last call (or the init) divided by its repetitions, then a new phase starts: called
+// after the warm-up runs to discard them, and after the repetitions of each phase. The bandwidth is over the wall time
+// of the kernel regions, as the times enabled of the events add up over the threads.
+static inline CounterValues countersCollect(int rep) {
+    CounterValues values = {NAN, NAN, NAN, NAN, NAN};
+    uint64_t current[COUNTER_EVENTS][3];
+    double delta[COUNTER_EVENTS];
+
+    if (!counters.enabled) return values;
+
+    memcpy(current, counters.base, sizeof(current));
+    for (int e = 0; e < COUNTER_EVENTS; e++) delta[e] = countersDelta(e, current[e]);
+    double seconds = counters.seconds;
+    memcpy(counters.base, current, sizeof(current));
+    counters.seconds = 0;
+
+    rep = rep > 0 ? rep : 1;
+    values.cycles = delta[0] / rep;
+    values.instructions = delta[1] / rep;
+    values.llc_misses = delta[2] / rep;
+    values.dtlb_misses = delta[3] / rep;
+    values.bandwidth = seconds > 0 ? delta[2] * COUNTER_LINE / seconds * 1e-9 : NAN;
+
+    return values;
+}
+
+static inline void countersReset() {
+    countersCollect(1);
+}
+
+static inline void printCounterValues(const CounterValues* values) {
+    printf("\t\t cycles %.0f\tinstructions %.0f (IPC %.2f)\tLLC misses %.0f\tdTLB misses %.0f\tmemory %.2f GB/s\n", values->cycles,
+           values->instructions, values->instructions / values->cycles, values->llc_misses, values->dtlb_misses, values->bandwidth);
+}
+
+#ifdef MPI_VERSION
+// Counts and bandwidths of the processes summed, significant on rank 0 only. A process with no counters holds nan, so
+// the totals are nan rather than partial
+static inline CounterValues countersCollectMPI(int rep, MPI_Comm comm) {
+    CounterValues values = countersCollect(rep);
+    CounterValues total;
+    int any, enabled = counters.enabled;
+
+    MPI_Allreduce(&enabled, &any, 1, MPI_INT, MPI_MAX, comm);
+    if (any) MPI_Reduce(&values, &total, 5, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+    return any ? total : values;
+}
+#endif
+
+#endif
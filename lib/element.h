@@ -0,0 +1,206 @@
+#ifndef ELEMENT_H
+#define ELEMENT_H
+
+#include <complex.h>
+#include <immintrin.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "functions.h"
+#include "simd.h"
+
+#define FLOAT_EPSILON 1e-4  // tolerance of the single precision symmetry checks, EPSILON for double precision
+
+// Element types of the generic kernels, ELEMENT_BYTES for records of any fixed size compared byte by byte
+typedef enum {
+    ELEMENT_DOUBLE,
+    ELEMENT_FLOAT,
+    ELEMENT_INT32,
+    ELEMENT_INT64,
+    ELEMENT_COMPLEX_FLOAT,
+    ELEMENT_COMPLEX_DOUBLE,
+    ELEMENT_BYTES
+} ElementType;
+
+// Generic tile and symmetry kernels, with the same arguments of TileKernel and SymKernel counted in elements of size bytes
+typedef void (*TileKernelAny)(const void* src, void* dst, int rows, int cols, int lds, int ldd, size_t size);
+typedef bool (*SymKernelAny)(const void* a, const void* b, int rows, int cols, int lda, int ldb, double eps, size_t size);
+
+typedef struct {
+    size_t size;
+    double eps;                // tolerance of the symmetry checks, 0 for exact comparisons
+    TileKernelAny tile;        // SIMD shuffles of the element size, when there are
+    TileKernelAny tile_scalar;
+    SymKernelAny sym;
+    SymKernelAny hermitian;  // a == conj(b^T), the same as sym for the real types
+} ElementOps;
+
+// A transpose only moves elements, so the tile kernels depend on the element size and not on its type: one scalar
+// kernel is generated per size, and a plan binds the kernels of its type once
+
+#define DEFINE_TILE_KERNEL(name, type)                                                                          \
+    static inline void name(const void* src, void* dst, int rows, int cols, int lds, int ldd, size_t size) { \
+        (void)size;                                                                                          \
+        for (int i = 0; i < rows; i++) {                                                                     \
+            for (int j = 0; j < cols; j++) {                                                                 \
+                ((type*)dst)[(size_t)j * ldd + i] = ((const type*)src)[(size_t)i * lds + j];                \
+            }                                                                                                \
+        }                                                                                                    \
+    }
+
+typedef struct {
+    uint64_t low, high;
+} Element128;
+
+DEFINE_TILE_KERNEL(transposeTileScalar32, uint32_t)
+DEFINE_TILE_KERNEL(transposeTileScalar64, uint64_t)
+DEFINE_TILE_KERNEL(transposeTileScalar128, Element128)
+
+static inline void transposeTileBytes(const void* src, void* dst, int rows, int cols, int lds, int ldd, size_t size) {
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            memcpy((char*)dst + ((size_t)j * ldd + i) * size, (const char*)src + ((size_t)i * lds + j) * size, size);
+        }
+    }
+}
+
+// 8x8 micro-tile of 32-bit elements: unpack pairs of rows, shuffle pairs of pairs, then swap 128-bit lanes
+__attribute__((target("avx2"))) static inline void transpose8x8Float(const float* src, float* dst, int lds, int ldd) {
+    __m256 r[8], t[8], u[8];
+    for (int i = 0; i < 8; i++) r[i] = _mm256_loadu_ps(src + (size_t)i * lds);
+
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        u[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        u[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        u[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (int i = 0; i < 4; i++) {
+        r[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+    }
+
+    for (int i = 0; i < 8; i++) _mm256_storeu_ps(dst + (size_t)i * ldd, r[i]);
+}
+
+__attribute__((target("avx2"))) static inline void transposeTile32AVX2(const void* src, void* dst, int rows, int cols, int lds, int ldd, size_t size) {
+    const float* s = (const float*)src;
+    float* d = (float*)dst;
+    int i = 0;
+    for (; i + 8 <= rows; i += 8) {
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            transpose8x8Float(s + (size_t)i * lds + j, d + (size_t)j * ldd + i, lds, ldd);
+        }
+        transposeTileScalar32(s + (size_t)i * lds + j, d + (size_t)j * ldd + i, 8, cols - j, lds, ldd, size);
+    }
+    transposeTileScalar32(s + (size_t)i * lds, d + i, rows - i, cols, lds, ldd, size);
+}
+
+// 2x2 micro-tile of 128-bit elements: one register per row of two elements, lanes swapped
+__attribute__((target("avx2"))) static inline void transposeTile128AVX2(const void* src, void* dst, int rows, int cols, int lds, int ldd, size_t size) {
+    const double* s = (const double*)src;
+    double* d = (double*)dst;
+    int i = 0;
+    for (; i + 2 <= rows; i += 2) {
+        int j = 0;
+        for (; j + 2 <= cols; j += 2) {
+            __m256d r0 = _mm256_loadu_pd(s + 2 * ((size_t)i * lds + j));
+            __m256d r1 = _mm256_loadu_pd(s + 2 * ((size_t)(i + 1) * lds + j));
+            _mm256_storeu_pd(d + 2 * ((size_t)j * ldd + i), _mm256_permute2f128_pd(r0, r1, 0x20));
+            _mm256_storeu_pd(d + 2 * ((size_t)(j + 1) * ldd + i), _mm256_permute2f128_pd(r0, r1, 0x31));
+        }
+        transposeTileScalar128(s + 2 * ((size_t)i * lds + j), d + 2 * ((size_t)j * ldd + i), 2, cols - j, lds, ldd, size);
+    }
+    transposeTileScalar128(s + 2 * (size_t)i * lds, d + 2 * i, rows - i, cols, lds, ldd, size);
+}
+
+// 64-bit elements go through the double precision kernels selected by CPUID, which only move bits
+static TileKernel element_tile_kernel = transposeTileScalar;
+static SymKernel element_sym_kernel = checkTileSymScalar;
+
+static inline void transposeTile64(const void* src, void* dst, int rows, int cols, int lds, int ldd, size_t size) {
+    (void)size;
+    element_tile_kernel((const double*)src, (double*)dst, rows, cols, lds, ldd);
+}
+
+static inline bool checkTileSymDouble(const void* a, const void* b, int rows, int cols, int lda, int ldb, double eps, size_t size) {
+    (void)size;
+    return element_sym_kernel((const double*)a, (const double*)b, rows, cols, lda, ldb, eps);
+}
+
+// Symmetry kernels of the other types, comparing a[i][j] with b[j][i] up to the first distance above eps
+
+#define REAL_DISTANCE(x, y) fabs((double)(x) - (double)(y))
+#define INTEGER_DISTANCE(x, y) ((x) == (y) ? 0.0 : INFINITY)
+#define COMPLEX_DISTANCE(x, y) cabs((double complex)(x) - (double complex)(y))
+#define CONJUGATE_DISTANCE(x, y) cabs((double complex)(x) - conj((double complex)(y)))
+
+#define DEFINE_SYM_KERNEL(name, type, distance)                                                                              \
+    static inline bool name(const void* a, const void* b, int rows, int cols, int lda, int ldb, double eps, size_t size) { \
+        const type* x = (const type*)a;                                                                                    \
+        const type* y = (const type*)b;                                                                                    \
+        (void)size;                                                                                                        \
+        for (int i = 0; i < rows; i++) {                                                                                   \
+            for (int j = 0; j < cols; j++) {                                                                               \
+                if (distance(x[(size_t)i * lda + j], y[(size_t)j * ldb + i]) > eps) return false;                         \
+            }                                                                                                              \
+        }                                                                                                                  \
+        return true;                                                                                                       \
+    }
+
+DEFINE_SYM_KERNEL(checkTileSymFloat, float, REAL_DISTANCE)
+DEFINE_SYM_KERNEL(checkTileSymInt32, int32_t, INTEGER_DISTANCE)
+DEFINE_SYM_KERNEL(checkTileSymInt64, int64_t, INTEGER_DISTANCE)
+DEFINE_SYM_KERNEL(checkTileSymComplexFloat, float complex, COMPLEX_DISTANCE)
+DEFINE_SYM_KERNEL(checkTileSymComplexDouble, double complex, COMPLEX_DISTANCE)
+DEFINE_SYM_KERNEL(checkTileHermitianFloat, float complex, CONJUGATE_DISTANCE)
+DEFINE_SYM_KERNEL(checkTileHermitianDouble, double complex, CONJUGATE_DISTANCE)
+
+static inline bool checkTileSymBytes(const void* a, const void* b, int rows, int cols, int lda, int ldb, double eps, size_t size) {
+    (void)eps;  // records are compared byte by byte
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (memcmp((const char*)a + ((size_t)i * lda + j) * size, (const char*)b + ((size_t)j * ldb + i) * size, size) != 0) return false;
+        }
+    }
+    return true;
+}
+
+// Kernels and tolerance of the element type, size is only read for ELEMENT_BYTES
+static inline ElementOps elementOps(ElementType type, size_t size) {
+    const size_t sizes[] = {sizeof(double), sizeof(float), sizeof(int32_t), sizeof(int64_t), sizeof(float complex), sizeof(double complex), size};
+    const double tolerances[] = {EPSILON, FLOAT_EPSILON, 0, 0, FLOAT_EPSILON, EPSILON, 0};
+    const SymKernelAny sym[] = {checkTileSymDouble, checkTileSymFloat, checkTileSymInt32, checkTileSymInt64,
+                                checkTileSymComplexFloat, checkTileSymComplexDouble, checkTileSymBytes};
+    const SymKernelAny hermitian[] = {checkTileSymDouble, checkTileSymFloat, checkTileSymInt32, checkTileSymInt64,
+                                      checkTileHermitianFloat, checkTileHermitianDouble, checkTileSymBytes};
+    bool avx2 = simdLevel() >= SIMD_AVX2;
+    ElementOps ops;
+
+    element_tile_kernel = selectTileKernel();
+    element_sym_kernel = selectSymKernel();
+
+    ops.size = sizes[type];
+    ops.eps = tolerances[type];
+    ops.sym = sym[type];
+    ops.hermitian = hermitian[type];
+    ops.tile_scalar = ops.size == 4 ? transposeTileScalar32
+                    : ops.size == 8 ? transposeTileScalar64
+                    : ops.size == 16 ? transposeTileScalar128
+                    : transposeTileBytes;
+    ops.tile = ops.size == 8 ? transposeTile64
+             : ops.size == 4 && avx2 ? transposeTile32AVX2
+             : ops.size == 16 && avx2 ? transposeTile128AVX2
+             : ops.tile_scalar;
+
+    return ops;
+}
+
+#endif
@@ -1,14 +1,35 @@
+#ifndef FUNCTIONS_H
+#define FUNCTIONS_H
+
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "allocator.h"
+#include "benchmark.h"
+#include "counters.h"
+
 #define EPSILON 1e-6
 #define FILE_NAME_MPI "results_mpi.csv"
+#define SYM_STRIPE 64  // rows of a stripe of the symmetry checks, and scanned between two polls of the distributed flag
+#define TEST_BLOCK 64  // tiles of the verification, so that the rows and the columns compared are read by cache lines
+
+// Loops over independent rows shared by the OpenMP threads when compiled with -fopenmp, serial otherwise
+#ifdef _OPENMP
+#define PRAGMA(x) _Pragma(#x)
+#define PARALLEL_FOR(clauses) PRAGMA(omp parallel for clauses)
+#else
+#define PARALLEL_FOR(clauses)
+#endif
 
-void printMatrix(const double* M, int n) {
+static unsigned int matrix_seed = 0;   // seed of the generated input, kept to regenerate it when testing
+static bool matrix_symmetric = false;  // generated input mirrored to be symmetric (worst case of the symmetry check)
+
+static inline void printMatrix(const double* M, int n) {
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < n; j++) {
             printf("%10g ", M[i * n + j]);
@@ -18,71 +39,213 @@ void printMatrix(const double* M, int n) {
     printf("\n");
 }
 
-double elapsedTime(struct timespec s, struct timespec e) {
+static inline double elapsedTime(struct timespec s, struct timespec e) {
     long seconds = e.tv_sec - s.tv_sec;
     long nanoseconds = e.tv_nsec - s.tv_nsec;
     double time = seconds + nanoseconds * 1e-9;
     return time;
 }
 
-int saveResultsMPI(const char* code, int n, int processes, double t1m, double t1e, double t2m, double t2e) {
+// One row per run: the mean times of the repetitions (message passing included) and the effective times, then the
+// median, 95th percentile, minimum and standard deviation of each phase, then the hardware counters of each phase. s1 is
+// NULL for the programs with no symmetry check, whose columns are then nan.
+static inline int saveResultsMPI(const char* code, int n, int processes, int threads, const BenchmarkStats* s1, double t1e, const BenchmarkStats* s2, double t2e,
+                                 const CounterValues* c1, const CounterValues* c2) {
+    BenchmarkStats none = {NAN, NAN, NAN, NAN, NAN};
+    CounterValues no_counters = {NAN, NAN, NAN, NAN, NAN};
     FILE* f = fopen(FILE_NAME_MPI, "a");
 
     if (f == NULL) return -1;
+    if (s1 == NULL) {
+        s1 = &none;
+        t1e = NAN;
+        c1 = &no_counters;
+    }
 
-    fprintf(f, "%s,%d,%d,%.9f,%.9f,%.9f,%.9f\n", code, n, processes, t1m, t1e, t2m, t2e);
+    fprintf(f, "%s,%d,%d,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f", code, n, processes, threads,
+            s1->mean, t1e, s2->mean, t2e, s1->median, s1->p95, s1->min, s1->stddev, s2->median, s2->p95, s2->min, s2->stddev);
+    fprintf(f, ",%.0f,%.0f,%.0f,%.0f,%.3f,%.0f,%.0f,%.0f,%.0f,%.3f\n", c1->cycles, c1->instructions, c1->llc_misses, c1->dtlb_misses,
+            c1->bandwidth, c2->cycles, c2->instructions, c2->llc_misses, c2->dtlb_misses, c2->bandwidth);
     fclose(f);
 
     return 0;
 }
 
-int initMatrices(double** M, double** T, int n) {
-    *M = (double*)malloc(n * n * sizeof(double));
-    *T = (double*)malloc(n * n * sizeof(double));
+// Returns the value of an optional "key=value" (or bare "key") argument passed after [n] [rep], NULL if missing
+static inline const char* getOption(int argc, char** argv, const char* key) {
+    size_t length = strlen(key);
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], key, length) == 0) {
+            if (argv[i][length] == '=') return argv[i] + length + 1;
+            if (argv[i][length] == '\0') return argv[i] + length;
+        }
+    }
+    return NULL;
+}
 
-    if (*M == NULL || *T == NULL) {
-        free(*M);
-        free(*T);
-        return -1;
+// Matrix dimension from the first argument: an exponent of 2, or any size passed as "n=<size>"
+static inline unsigned int parseDimension(const char* arg) {
+    if (strncmp(arg, "n=", 2) == 0) return atoi(arg + 2);
+    return pow(2, atoi(arg));
+}
+
+// Counter-based generator: the entry (i, j) is a hash of the seed and its position, so any slab can be generated
+// independently of the others. A symmetric input hashes the position in the lower triangular part.
+static inline double randomEntry(unsigned int seed, int n, int i, int j) {
+    if (matrix_symmetric && j > i) {
+        int swap = i;
+        i = j;
+        j = swap;
     }
 
-    srand(time(0));
-    for (int i = 0; i < n; i++) {
+    unsigned long long x = seed + ((unsigned long long)i * n + j + 1) * 0x9E3779B97F4A7C15ULL;  // splitmix64
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x = x ^ (x >> 31);
+
+    return (double)(x >> 11) * 0x1.0p-53 * 100;
+}
+
+// Generates only the rows [row_start, row_start + rows) of the input, stored in a rows x n slab: every entry depends on
+// the seed and its position only, so the rows are generated by the threads (and the slabs by the ranks) in any order
+static inline void fillSlab(double* slab, int n, int row_start, int rows) {
+    PARALLEL_FOR(schedule(static))
+    for (int i = 0; i < rows; i++) {
         for (int j = 0; j < n; j++) {
-            (*M)[i * n + j] = (double)rand() / RAND_MAX * 100;
+            slab[(size_t)i * n + j] = randomEntry(matrix_seed, n, row_start + i, j);
         }
     }
+}
+
+static inline void fillMatrix(double* M, int n) {
+    fillSlab(M, n, 0, n);
+}
+
+// Allocates M and, if T is not NULL, T, with no content
+static inline int allocMatrices(double** M, double** T, int n) {
+    *M = (double*)allocBuffer((size_t)n * n * sizeof(double));
+    if (T != NULL) *T = (double*)allocBuffer((size_t)n * n * sizeof(double));
+
+    if (*M == NULL || (T != NULL && *T == NULL)) {
+        freeBuffer(*M);
+        if (T != NULL) freeBuffer(*T);
+        return -1;
+    }
 
     return 0;
 }
 
-void testResults(double* M, double* T, int n) {
-    bool check = true;
-    bool transposed = true;
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            if (fabs(M[i * n + j] - M[j * n + i]) > EPSILON) {
-                check = false;
+static inline int initMatrices(double** M, double** T, int n) {
+    if (allocMatrices(M, T, n) == -1) return -1;
+
+    matrix_seed = time(0);
+    fillMatrix(*M, n);
+
+    return 0;
+}
+
+// Allocates a batch of count matrices stored one after the other, the matrix b generated from the seed plus b
+static inline int initBatch(double** M, double** T, int n, int count) {
+    *M = (double*)allocBuffer((size_t)count * n * n * sizeof(double));
+    *T = (double*)allocBuffer((size_t)count * n * n * sizeof(double));
+
+    if (*M == NULL || *T == NULL) {
+        freeBuffer(*M);
+        freeBuffer(*T);
+        return -1;
+    }
+
+    matrix_seed = time(0);
+    PARALLEL_FOR(collapse(2) schedule(static))
+    for (int b = 0; b < count; b++) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                (*M)[((size_t)b * n + i) * n + j] = randomEntry(matrix_seed + b, n, i, j);
             }
+        }
+    }
+
+    return 0;
+}
+
+// Allocates only the input matrix, for the in-place transposes
+static inline int initMatrix(double** M, int n) {
+    if (allocMatrices(M, NULL, n) == -1) return -1;
 
-            if (T[j * n + i] != M[i * n + j]) {
-                transposed = false;
+    matrix_seed = time(0);
+    fillMatrix(*M, n);
+
+    return 0;
+}
+
+// Symmetry of M and T == M^T, compared by tiles of TEST_BLOCK x TEST_BLOCK: the column accesses of a tile stay in the
+// cache lines loaded by its first rows. The flags are only cleared, so the loops have no early exit to vectorize.
+static inline void compareTransposed(const double* M, const double* T, int n, bool* check, bool* transposed) {
+    bool symmetric = true, equal = true;
+
+    PARALLEL_FOR(schedule(dynamic) reduction(& : symmetric, equal))
+    for (int ii = 0; ii < n; ii += TEST_BLOCK) {
+        for (int jj = 0; jj < n; jj += TEST_BLOCK) {
+            int i_end = ii + TEST_BLOCK < n ? ii + TEST_BLOCK : n;
+            int j_end = jj + TEST_BLOCK < n ? jj + TEST_BLOCK : n;
+            for (int i = ii; i < i_end; i++) {
+                for (int j = jj; j < j_end; j++) {
+                    symmetric &= fabs(M[(size_t)i * n + j] - M[(size_t)j * n + i]) <= EPSILON;
+                    equal &= T[(size_t)j * n + i] == M[(size_t)i * n + j];
+                }
             }
         }
     }
 
+    *check = symmetric;
+    *transposed = equal;
+}
+
+static inline void testResults(double* M, double* T, int n) {
+    bool check, transposed;
+
+    compareTransposed(M, T, n, &check, &transposed);
+
     printf("Tested results: symmetry %s and transposed %s.\n\n", check ? "true" : "false", transposed ? "correct" : "incorrect");
 }
 
-void testResultsBlock(double* M, double* T, int n) {
+static inline void testResultsBlock(double* M, double* T, int n) {
+    bool check, transposed;
+
+    compareTransposed(M, T, n, &check, &transposed);
+
+    printf("Tested results: transposed %s.\n\n", transposed ? "correct" : "incorrect");
+}
+
+static inline void testResultsBatch(double* M, double* T, int n, int count) {
+    int symmetric = 0;
+    bool transposed = true;
+    for (int b = 0; b < count; b++) {
+        bool check, equal;
+        size_t k = (size_t)b * n * n;
+
+        compareTransposed(M + k, T + k, n, &check, &equal);
+        symmetric += check;
+        transposed &= equal;
+    }
+
+    printf("Tested results: %d of %d symmetric and transposed %s.\n\n", symmetric, count, transposed ? "correct" : "incorrect");
+}
+
+// Regenerates the input from its seed, M is expected transposed after an odd number of in-place transposes: the entry
+// (i, j) is then the generated (j, i), so M is still read by rows
+static inline void testResultsInPlace(const double* M, int n, int transposes) {
     bool transposed = true;
+
+    PARALLEL_FOR(schedule(static) reduction(& : transposed))
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < n; j++) {
-            if (T[j * n + i] != M[i * n + j]) {
-                transposed = false;
-            }
+            double value = transposes % 2 == 1 ? randomEntry(matrix_seed, n, j, i) : randomEntry(matrix_seed, n, i, j);
+            transposed &= M[(size_t)i * n + j] == value;
         }
     }
 
-    printf("Tested results: transposed %s.\n\n", transposed ? "correct" : "incorrect");
-}
\ No newline at end of file
+    printf("Tested results: in-place transposed %s.\n\n", transposed ? "correct" : "incorrect");
+}
+
+#endif
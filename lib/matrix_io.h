@@ -0,0 +1,229 @@
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary matrix file: a 64 bytes header followed by the rows x cols elements in the layout of the header, in the byte
+// order of the machine that wrote it
+#define MATRIX_MAGIC "PARCOMAT"
+#define MATRIX_VERSION 1
+#define MATRIX_HEADER_SIZE 64
+
+#define MATRIX_DOUBLE 1  // element types
+
+#define MATRIX_ROW_MAJOR 0  // layouts
+#define MATRIX_COLUMN_MAJOR 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t element_size;
+    uint32_t layout;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t checksum;  // matrixChecksum of the elements, 0 if not computed
+    char reserved[MATRIX_HEADER_SIZE - 48];
+} MatrixHeader;
+
+static inline void matrixHeaderInit(MatrixHeader* header, uint64_t rows, uint64_t cols, uint32_t layout) {
+    memset(header, 0, sizeof(MatrixHeader));
+    memcpy(header->magic, MATRIX_MAGIC, sizeof(header->magic));
+    header->version = MATRIX_VERSION;
+    header->dtype = MATRIX_DOUBLE;
+    header->element_size = sizeof(double);
+    header->layout = layout;
+    header->rows = rows;
+    header->cols = cols;
+}
+
+// A header of a square row-major matrix of doubles, the only shape of the transposes
+static inline bool matrixHeaderValid(const MatrixHeader* header) {
+    return memcmp(header->magic, MATRIX_MAGIC, sizeof(header->magic)) == 0 && header->version == MATRIX_VERSION &&
+           header->dtype == MATRIX_DOUBLE && header->element_size == sizeof(double) &&
+           header->layout == MATRIX_ROW_MAJOR && header->rows == header->cols && header->rows > 0;
+}
+
+// Sum of the FNV-1a hashes of the rows [row_start, row_start + rows), each seeded with its index: the slabs of the
+// processes are hashed independently and summed
+static inline uint64_t matrixChecksum(const double* slab, uint64_t cols, uint64_t row_start, uint64_t rows) {
+    uint64_t checksum = 0;
+
+    for (uint64_t i = 0; i < rows; i++) {
+        const unsigned char* bytes = (const unsigned char*)(slab + i * cols);
+        uint64_t hash = 0xCBF29CE484222325ULL ^ (row_start + i);
+        for (uint64_t k = 0; k < cols * sizeof(double); k++) hash = (hash ^ bytes[k]) * 0x100000001B3ULL;
+        checksum += hash;
+    }
+    return checksum;
+}
+
+// Writes the whole matrix with its header, with the checksum if requested
+static inline int writeMatrixFile(const char* name, const double* M, int n, bool checksum) {
+    MatrixHeader header;
+    FILE* f = fopen(name, "wb");
+
+    if (f == NULL) return -1;
+
+    matrixHeaderInit(&header, n, n, MATRIX_ROW_MAJOR);
+    if (checksum) header.checksum = matrixChecksum(M, n, 0, n);
+
+    size_t written = fwrite(&header, sizeof(MatrixHeader), 1, f);
+    written += fwrite(M, sizeof(double) * n, n, f);
+    fclose(f);
+
+    return written == (size_t)n + 1 ? 0 : -1;
+}
+
+// Maps the file read-only, with no copy: returns the first element, NULL if the file is not a valid matrix or its
+// checksum does not match. The mapping is released by unmapMatrixFile with the returned length.
+static inline const double* mapMatrixFile(const char* name, MatrixHeader* header, size_t* length) {
+    struct stat info;
+    int fd = open(name, O_RDONLY);
+
+    if (fd == -1) return NULL;
+    if (fstat(fd, &info) == -1 || (size_t)info.st_size < MATRIX_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    void* base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    memcpy(header, base, sizeof(MatrixHeader));
+    *length = info.st_size;
+
+    const double* M = (const double*)((const char*)base + MATRIX_HEADER_SIZE);
+    bool valid = matrixHeaderValid(header) && (size_t)info.st_size >= MATRIX_HEADER_SIZE + header->rows * header->cols * sizeof(double);
+    if (valid) madvise(base, info.st_size, MADV_SEQUENTIAL);
+    if (valid && header->checksum != 0) valid = matrixChecksum(M, header->cols, 0, header->rows) == header->checksum;
+
+    if (!valid) {
+        munmap(base, info.st_size);
+        return NULL;
+    }
+    return M;
+}
+
+static inline void unmapMatrixFile(const double* M, size_t length) {
+    munmap((char*)M - MATRIX_HEADER_SIZE, length);
+}
+
+#ifdef MPI_VERSION
+// Header read by rank 0 and broadcast, -1 on every process if the file is not a valid matrix
+static inline int readMatrixHeaderMPI(MPI_File file, MatrixHeader* header, MPI_Comm comm) {
+    int rank, valid = 0;
+
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0) {
+        valid = MPI_File_read_at(file, 0, header, sizeof(MatrixHeader), MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS &&
+                matrixHeaderValid(header);
+    }
+    MPI_Bcast(&valid, 1, MPI_INT, 0, comm);
+    MPI_Bcast(header, sizeof(MatrixHeader), MPI_BYTE, 0, comm);
+
+    return valid ? 0 : -1;
+}
+
+// Every process reads with a collective call only its part of the elements, described by filetype in units of
+// MPI_DOUBLE from the element at displacement (e.g. its slab of rows, or a block of a distributed layout). The local
+// buffer holds count items of type, e.g. whole rows, so that a slab of more than INT_MAX doubles is read in one call.
+static inline int readMatrixViewMPI(MPI_File file, MPI_Offset displacement, double* local, int count, MPI_Datatype type, MPI_Datatype filetype) {
+    MPI_File_set_view(file, MATRIX_HEADER_SIZE + displacement * sizeof(double), MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+    return MPI_File_read_at_all(file, 0, local, count, type, MPI_STATUS_IGNORE) == MPI_SUCCESS ? 0 : -1;
+}
+
+static inline int writeMatrixViewMPI(MPI_File file, MPI_Offset displacement, const double* local, int count, MPI_Datatype type, MPI_Datatype filetype) {
+    MPI_File_set_view(file, MATRIX_HEADER_SIZE + displacement * sizeof(double), MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+    return MPI_File_write_at_all(file, 0, local, count, type, MPI_STATUS_IGNORE) == MPI_SUCCESS ? 0 : -1;
+}
+
+// Row of a row-major n x n matrix: a slab of rows is a sequence of rows from the first one
+static inline MPI_Datatype rowTypeMPI(int n) {
+    MPI_Datatype type_row_n;
+
+    MPI_Type_contiguous(n, MPI_DOUBLE, &type_row_n);
+    MPI_Type_commit(&type_row_n);
+    return type_row_n;
+}
+
+// Dimension of the matrix file, -1 on every process if it is not a valid matrix
+static inline int readMatrixDimensionMPI(const char* name, MPI_Comm comm) {
+    MPI_File file;
+    MatrixHeader header;
+
+    if (MPI_File_open(comm, name, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) return -1;
+    int result = readMatrixHeaderMPI(file, &header, comm);
+    MPI_File_close(&file);
+
+    return result == 0 ? (int)header.rows : -1;
+}
+
+// Reads the slab of rows [row_start, row_start + rows) of the matrix file, whose dimension must be n
+static inline int readSlabMPI(const char* name, double* slab, int n, int row_start, int rows, MPI_Comm comm) {
+    MPI_File file;
+    MatrixHeader header;
+
+    if (MPI_File_open(comm, name, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) return -1;
+
+    int result = readMatrixHeaderMPI(file, &header, comm);
+    if (result == 0 && header.rows != (uint64_t)n) result = -1;
+
+    if (result == 0) {
+        MPI_Datatype type_row_n = rowTypeMPI(n);
+        result = readMatrixViewMPI(file, (MPI_Offset)row_start * n, slab, rows, type_row_n, type_row_n);
+        MPI_Type_free(&type_row_n);
+    }
+    if (result == 0 && header.checksum != 0) {
+        uint64_t local_checksum = matrixChecksum(slab, n, row_start, rows), checksum;
+        MPI_Allreduce(&local_checksum, &checksum, 1, MPI_UINT64_T, MPI_SUM, comm);
+        if (checksum != header.checksum) result = -1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_INT, MPI_MIN, comm);
+
+    MPI_File_close(&file);
+    return result;
+}
+
+// Writes the slabs of all the processes and the header, with the checksum if requested
+static inline int writeSlabMPI(const char* name, const double* slab, int n, int row_start, int rows, bool checksum, MPI_Comm comm) {
+    MPI_File file;
+    MatrixHeader header;
+    int rank;
+
+    MPI_Comm_rank(comm, &rank);
+    if (MPI_File_open(comm, name, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file) != MPI_SUCCESS) return -1;
+    MPI_File_set_size(file, MATRIX_HEADER_SIZE + (MPI_Offset)n * n * sizeof(double));  // an older, larger file is truncated
+
+    matrixHeaderInit(&header, n, n, MATRIX_ROW_MAJOR);
+    if (checksum) {
+        uint64_t local_checksum = matrixChecksum(slab, n, row_start, rows);
+        MPI_Reduce(&local_checksum, &header.checksum, 1, MPI_UINT64_T, MPI_SUM, 0, comm);
+    }
+
+    MPI_Datatype type_row_n = rowTypeMPI(n);
+    int result = writeMatrixViewMPI(file, (MPI_Offset)row_start * n, slab, rows, type_row_n, type_row_n);
+    MPI_Type_free(&type_row_n);
+
+    // the header is outside of the views of the elements
+    MPI_File_set_view(file, 0, MPI_BYTE, MPI_BYTE, "native", MPI_INFO_NULL);
+    if (rank == 0 && MPI_File_write_at(file, 0, &header, sizeof(MatrixHeader), MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+        result = -1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_INT, MPI_MIN, comm);
+
+    MPI_File_close(&file);
+    return result;
+}
+#endif
+
+#endif
@@ -0,0 +1,271 @@
+#include <limits.h>
+#include <math.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
+
+#define CODE "MA"
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+SymKernel sym_kernel = checkTileSymScalar;     // selected at runtime by CPUID
+
+MPI_Datatype *send_types, *recv_types;                    // per rank, the blocks have uneven widths
+int *send_counts, *send_displs, *recv_counts, *recv_displs;  // displacements in bytes, the received ones in the types
+long exchange_bytes = 0;                                     // received by every exchange, for the trace
+
+// Every rank owns a balanced slab of rows of M: the block of the columns owned by rank q is sent to rank q with a
+// single all-to-all, so that the blocks received by rank q are the rows of its slab of M transposed
+void exchangeBlocks(double* local_M, double* blocks) {
+    double start = MPI_Wtime();
+    MPI_Alltoallw(local_M, send_counts, send_displs, send_types, blocks, recv_counts, recv_displs, recv_types, MPI_COMM_WORLD);
+    traceSpan("MPI_Alltoallw", -1, start, MPI_Wtime(), exchange_bytes);
+}
+
+bool checkSymMPI(double* local_M, double* blocks, int n, int rank, int size, double* t) {
+    int chunk = partitionRows(n, size, rank);
+    int max_rows = partitionRows(n, size, 0);  // same number of stripes on every rank
+    SymmetryFlag flag;
+
+    exchangeBlocks(local_M, blocks);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    // Block q of the slab must match the transposed block received from rank q, up to the diagonal block
+    symmetryFlagInit(&flag);
+    for (int i = 0; i < max_rows; i += SYM_STRIPE) {
+        if (!symmetryFlagPoll(&flag, MPI_COMM_WORLD)) break;
+
+        int rows = SYM_STRIPE < chunk - i ? SYM_STRIPE : chunk - i;
+        for (int q = 0; q <= rank && flag.local && rows > 0; q++) {
+            int q_start = partitionStart(n, size, q);
+            flag.local = sym_kernel(local_M + i * n + q_start, blocks + q_start * chunk + i, rows, partitionRows(n, size, q), n, chunk, EPSILON);
+        }
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    return symmetryFlagResult(&flag, MPI_COMM_WORLD);
+}
+
+void matTransposeMPI(double* local_M, double* local_T, double* blocks, int n, int rank, int size, double* t) {
+    int chunk = partitionRows(n, size, rank);
+
+    exchangeBlocks(local_M, blocks);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    for (int q = 0; q < size; q++) {
+        int q_start = partitionStart(n, size, q);
+        tile_kernel(blocks + q_start * chunk, local_T + q_start, partitionRows(n, size, q), chunk, chunk, n);
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+}
+
+int main(int argc, char** argv) {
+#ifndef MPI_VERSION
+    printf("Error: compile with MPI support!\n");
+    return -1;
+#endif
+
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [input=file] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+
+    // Setup MPI
+    int size, rank;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // The dimension of the input file replaces [n]
+    const char* input_name = getOption(argc, argv, "input");
+    if (input_name != NULL && (int)(n = readMatrixDimensionMPI(input_name, MPI_COMM_WORLD)) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Finalize();
+        return -1;
+    }
+
+    if (rank == 0) {
+        printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
+        printf("Matrix dimension: %d\n", n);
+        printf("Repetitions: %d\n", rep);
+        printf("Processes: %d\n\n", size);
+    }
+
+    // Variables declaration
+    double t1 = 0, t2 = 0;      // effective times
+    double t1m, t1e, t2m, t2e;  // execution times
+    BenchmarkStats s1, s2;      // statistics of the repetitions
+    CounterValues c1, c2;       // hardware counters of the repetitions
+    bool symmetric = false;     // symmetry check
+    double *local_M, *local_T;  // row slabs of the input and transposed matrices
+    double* blocks;             // blocks received from the other processes
+    int row_start = partitionStart(n, size, rank);
+    int chunk = partitionRows(n, size, rank);
+
+    // The slabs and the blocks exchanged are counted and indexed in int elements, the largest slab is the one of rank 0
+    if ((long)partitionRows(n, size, 0) * n > INT_MAX) {
+        if (rank == 0) printf("Error: slabs of more than %d elements, use more processes!\n\n", INT_MAX);
+        MPI_Finalize();
+        return -1;
+    }
+
+    // Slabs allocation: each process generates only its own rows, no process holds the whole matrix
+    local_M = (double*)allocBuffer((size_t)chunk * n * sizeof(double));
+    local_T = (double*)allocBuffer((size_t)chunk * n * sizeof(double));
+    blocks = (double*)allocBuffer((size_t)chunk * n * sizeof(double));
+
+    if (chunk > 0 && (local_M == NULL || local_T == NULL || blocks == NULL)) {
+        printf("Error in allocating matrices!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // Each process generates (or reads from the input file) only its rows
+    if (input_name == NULL) {
+        initSeedDistributed(MPI_COMM_WORLD);
+        fillSlab(local_M, n, row_start, chunk);
+    } else if (readSlabMPI(input_name, local_M, n, row_start, chunk, MPI_COMM_WORLD) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // Derived data types definition: the block sent to rank q is chunk x rows of q, received contiguously
+    send_types = (MPI_Datatype*)malloc(size * sizeof(MPI_Datatype));
+    recv_types = (MPI_Datatype*)malloc(size * sizeof(MPI_Datatype));
+    send_counts = (int*)malloc(size * sizeof(int));
+    send_displs = (int*)malloc(size * sizeof(int));
+    recv_counts = (int*)malloc(size * sizeof(int));
+    recv_displs = (int*)malloc(size * sizeof(int));
+
+    for (int q = 0; q < size; q++) {
+        MPI_Type_vector(chunk, partitionRows(n, size, q), n, MPI_DOUBLE, &send_types[q]);
+        MPI_Type_commit(&send_types[q]);
+        send_counts[q] = 1;
+        send_displs[q] = partitionStart(n, size, q) * sizeof(double);
+
+        MPI_Aint recv_offset = (MPI_Aint)partitionStart(n, size, q) * chunk * sizeof(double);  // past INT_MAX for large slabs
+        MPI_Type_create_hindexed_block(1, partitionRows(n, size, q) * chunk, &recv_offset, MPI_DOUBLE, &recv_types[q]);
+        MPI_Type_commit(&recv_types[q]);
+        recv_counts[q] = 1;
+        exchange_bytes += (long)partitionRows(n, size, q) * chunk * sizeof(double);
+        recv_displs[q] = 0;
+    }
+
+    tile_kernel = selectTileKernel();
+    sym_kernel = selectSymKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(local_M, blocks, n, rank, size, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(local_M, blocks, n, rank, size, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(local_M, local_T, blocks, n, rank, size, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(local_M, local_T, blocks, n, rank, size, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // Results printing and saving
+    MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
+
+        printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
+        printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, size, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
+            printf("Error in saving results!\n\n");
+        }
+    }
+
+    // The regenerated input can only check a generated matrix
+    if (input_name == NULL) testResultsDistributed(local_T, n, row_start, chunk, MPI_COMM_WORLD);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
+    // Matrices deallocation
+    freeBuffer(local_M);
+    freeBuffer(local_T);
+    freeBuffer(blocks);
+
+    // Derived data types deallocation
+    for (int q = 0; q < size; q++) {
+        MPI_Type_free(&send_types[q]);
+        MPI_Type_free(&recv_types[q]);
+    }
+    free(send_types);
+    free(recv_types);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    MPI_Finalize();
+
+    return 0;
+}
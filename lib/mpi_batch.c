@@ -0,0 +1,286 @@
+#include <math.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
+
+#define CODE "MM"
+#define BATCH 1024                // default number of matrices,
+#define BATCH_ELEMENTS (1 << 24)  // fewer for the large dimensions, up to 128 MB of doubles per batch
+#define BATCH_BLOCK 32            // tiles of the local transposes
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+SymKernel sym_kernel = checkTileSymScalar;
+
+// Batch plan: whole matrices are distributed across the ranks, so the matrices never cross a process boundary and a
+// call costs one scatter and one gather for the whole batch
+typedef struct {
+    int n, count;
+    MPI_Comm comm;
+    int rank, size;
+    MPI_Datatype type_matrix;
+    int *counts, *displs;  // balanced partition of the matrices
+    double *temp_in, *temp_out;
+    char *flags, *local_flags;  // symmetry of each matrix
+} BatchPlan;
+
+BatchPlan* batchPlanCreate(int n, int count) {
+    BatchPlan* plan = (BatchPlan*)malloc(sizeof(BatchPlan));
+    plan->n = n;
+    plan->count = count;
+    MPI_Comm_dup(MPI_COMM_WORLD, &plan->comm);
+    MPI_Comm_size(plan->comm, &plan->size);
+    MPI_Comm_rank(plan->comm, &plan->rank);
+
+    int chunk = partitionRows(count, plan->size, plan->rank);
+
+    MPI_Type_contiguous(n * n, MPI_DOUBLE, &plan->type_matrix);
+    MPI_Type_commit(&plan->type_matrix);
+
+    plan->counts = (int*)malloc(plan->size * sizeof(int));
+    plan->displs = (int*)malloc(plan->size * sizeof(int));
+    partitionCounts(count, plan->size, 1, plan->counts, plan->displs);
+
+    plan->temp_in = (double*)allocBuffer((size_t)chunk * n * n * sizeof(double));
+    plan->temp_out = (double*)allocBuffer((size_t)chunk * n * n * sizeof(double));
+    plan->local_flags = (char*)malloc(chunk > 0 ? chunk : 1);
+    plan->flags = (char*)malloc(count);
+
+    return plan;
+}
+
+void batchPlanDestroy(BatchPlan* plan) {
+    MPI_Type_free(&plan->type_matrix);
+    MPI_Comm_free(&plan->comm);
+
+    free(plan->counts);
+    free(plan->displs);
+    freeBuffer(plan->temp_in);
+    freeBuffer(plan->temp_out);
+    free(plan->local_flags);
+    free(plan->flags);
+    free(plan);
+}
+
+// Stripes of rows against the stripes of columns up to the diagonal, as in sequential.c
+bool checkSymMatrix(const double* M, int n) {
+    for (int i = 0; i < n; i += SYM_STRIPE) {
+        int rows = SYM_STRIPE < n - i ? SYM_STRIPE : n - i;
+        if (!sym_kernel(M + i * n, M + i, rows, i + rows, n, n, EPSILON)) return false;
+    }
+    return true;
+}
+
+// Returns the number of symmetric matrices on rank 0, whose flags are in plan->flags
+int checkSymBatch(BatchPlan* plan, double* M, double* t) {
+    int n = plan->n;
+    int chunk = partitionRows(plan->count, plan->size, plan->rank);
+    int symmetric = 0;
+
+    double start = MPI_Wtime();
+    MPI_Scatterv(M, plan->counts, plan->displs, plan->type_matrix, plan->temp_in, chunk, plan->type_matrix, 0, plan->comm);
+    traceSpan("MPI_Scatterv", -1, start, MPI_Wtime(), (long)chunk * n * n * sizeof(double));
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    for (int b = 0; b < chunk; b++) {
+        plan->local_flags[b] = checkSymMatrix(plan->temp_in + (size_t)b * n * n, n);
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    start = MPI_Wtime();
+    MPI_Gatherv(plan->local_flags, chunk, MPI_CHAR, plan->flags, plan->counts, plan->displs, MPI_CHAR, 0, plan->comm);
+    traceSpan("MPI_Gatherv", -1, start, MPI_Wtime(), chunk);
+
+    if (plan->rank == 0) {
+        for (int b = 0; b < plan->count; b++) symmetric += plan->flags[b];
+    }
+    return symmetric;
+}
+
+void matTransposeBatch(BatchPlan* plan, double* M, double* T, double* t) {
+    int n = plan->n;
+    int chunk = partitionRows(plan->count, plan->size, plan->rank);
+
+    double start = MPI_Wtime();
+    MPI_Scatterv(M, plan->counts, plan->displs, plan->type_matrix, plan->temp_in, chunk, plan->type_matrix, 0, plan->comm);
+    traceSpan("MPI_Scatterv", -1, start, MPI_Wtime(), (long)chunk * n * n * sizeof(double));
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    for (int b = 0; b < chunk; b++) {
+        const double* src = plan->temp_in + (size_t)b * n * n;
+        double* dst = plan->temp_out + (size_t)b * n * n;
+        for (int i = 0; i < n; i += BATCH_BLOCK) {
+            int rows = BATCH_BLOCK < n - i ? BATCH_BLOCK : n - i;
+            for (int j = 0; j < n; j += BATCH_BLOCK) {
+                int cols = BATCH_BLOCK < n - j ? BATCH_BLOCK : n - j;
+                tile_kernel(src + i * n + j, dst + j * n + i, rows, cols, n, n);
+            }
+        }
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    start = MPI_Wtime();
+    MPI_Gatherv(plan->temp_out, chunk, plan->type_matrix, T, plan->counts, plan->displs, plan->type_matrix, 0, plan->comm);
+    traceSpan("MPI_Gatherv", -1, start, MPI_Wtime(), (long)chunk * n * n * sizeof(double));
+}
+
+int main(int argc, char** argv) {
+#ifndef MPI_VERSION
+    printf("Error: compile with MPI support!\n");
+    return -1;
+#endif
+
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [batch=matrices] [symmetric] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    const char* batch_option = getOption(argc, argv, "batch");
+    int count = BATCH_ELEMENTS / ((long)n * n) < BATCH ? BATCH_ELEMENTS / ((long)n * n) : BATCH;
+    if (count < 1) count = 1;
+    if (batch_option != NULL && atoi(batch_option) > 0) count = atoi(batch_option);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+
+    // Setup MPI
+    int size, rank;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (rank == 0) {
+        printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
+        printf("Matrix dimension: %d\n", n);
+        printf("Batch: %d matrices\n", count);
+        printf("Repetitions: %d\n", rep);
+        printf("Processes: %d\n\n", size);
+    }
+
+    // Variables declaration
+    double t1 = 0, t2 = 0;      // effective times
+    double t1m, t1e, t2m, t2e;  // execution times
+    BenchmarkStats s1, s2;      // statistics of the repetitions, per batch
+    CounterValues c1, c2;       // hardware counters of the repetitions
+    int symmetric = 0;          // symmetric matrices of the batch
+    double* M = NULL;           // input matrices
+    double* T = NULL;           // transposed matrices
+
+    // Matrices allocation
+    if (rank == 0) {
+        if (initBatch(&M, &T, n, count) == -1) {
+            printf("Error in allocating matrices!\n\n");
+            MPI_Finalize();
+            return -1;
+        }
+    }
+
+    // Plan creation: data type, partition and buffers are set up once, outside the timed repetitions
+    BatchPlan* plan = batchPlanCreate(n, count);
+
+    tile_kernel = selectTileKernel();
+    sym_kernel = selectSymKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int i = 0; i < bench.warmup; i++) symmetric = checkSymBatch(plan, M, &t1);
+    t1 = 0;
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymBatch(plan, M, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, i);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep * count, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int i = 0; i < bench.warmup; i++) matTransposeBatch(plan, M, T, &t2);
+    t2 = 0;
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        matTransposeBatch(plan, M, T, &t2);
+        benchmarkStop(&bench, i);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep * count, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // Results printing and saving: the times and statistics saved are per matrix, as the ones of the other programs
+    MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        benchmarkScaleStats(&s1, 1.0 / count);
+        benchmarkScaleStats(&s2, 1.0 / count);
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep / count;
+        t2e = t2e / rep / count;
+
+        printf("Parallel execution (message passing included and excluded): symmetric matrices: %d of %d\n", symmetric, count);
+        printf("checkSymBatch:\t    %.9f\t%.9f seconds per matrix\t%.0f matrices/s\n", t1m, t1e, 1 / t1m);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeBatch: %.9f\t%.9f seconds per matrix\t%.0f matrices/s\n", t2m, t2e, 1 / t2m);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        testResultsBatch(M, T, n, count);
+
+        if (saveResultsMPI(CODE, n, size, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
+            printf("Error in saving results!\n\n");
+        }
+    }
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
+    // Matrices deallocation
+    if (rank == 0) {
+        freeBuffer(M);
+        freeBuffer(T);
+    }
+
+    batchPlanDestroy(plan);
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -6,74 +6,198 @@
 #include <time.h>
 
 #include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
+#include "wisdom.h"
 
 #define CODE "MB"
+#define CODE_IN_PLACE "MBI"
+
+#define BLOCK_SIZE 32       // default block size, without wisdom or bs= option
+#define TUNE_REPETITIONS 4  // even, so that tuning leaves the in-place input as it was
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+
+// Transpose plan, created once per shape and block size and executed by every call with no setup. Index 0 of the types
+// is for the rows of blocks of bs rows, index 1 for the last one, narrower when n is not a multiple of bs
+typedef struct {
+    PlanKey key;
+    MPI_Comm comm;
+    int rank, size;
+    int width, blocks_per_row;
+    MPI_Datatype block_send_type[2], block_partition_type[2], block_recv_type[2];
+    int *band_counts, *band_displs;  // columns of M (rows of T) owned by every process, in whole blocks
+    double *band, *band_T;           // temporary band of blocks and its transpose
+} BlockPlan;
+
+void blockPlanDestroy(void* p) {
+    BlockPlan* plan = (BlockPlan*)p;
+
+    for (int last = 0; last < 2; last++) {
+        MPI_Type_free(&plan->block_send_type[last]);
+        MPI_Type_free(&plan->block_partition_type[last]);
+        MPI_Type_free(&plan->block_recv_type[last]);
+    }
+    MPI_Comm_free(&plan->comm);
+
+    free(plan->band_counts);
+    free(plan->band_displs);
+    freeBuffer(plan->band);
+    freeBuffer(plan->band_T);
+    free(plan);
+}
+
+// Plan of the shape outside the cache, owned by the caller
+BlockPlan* blockPlanBuild(PlanKey key) {
+    int n = key.n;
+    int bs = key.block_size;
+
+    BlockPlan* plan = (BlockPlan*)malloc(sizeof(BlockPlan));
+    plan->key = key;
+    MPI_Comm_dup(MPI_COMM_WORLD, &plan->comm);
+    MPI_Comm_size(plan->comm, &plan->size);
+    MPI_Comm_rank(plan->comm, &plan->rank);
+
+    // Columns split among the processes in whole blocks, the last block may be narrower
+    plan->blocks_per_row = (n + bs - 1) / bs;
+    plan->band_counts = (int*)malloc(plan->size * sizeof(int));
+    plan->band_displs = (int*)malloc(plan->size * sizeof(int));
+    for (int k = 0; k < plan->size; k++) {
+        int start = partitionStart(plan->blocks_per_row, plan->size, k) * bs;
+        int end = partitionStart(plan->blocks_per_row, plan->size, k + 1) * bs;
+        plan->band_displs[k] = start < n ? start : n;
+        plan->band_counts[k] = (end < n ? end : n) - plan->band_displs[k];
+    }
+
+    int width = plan->width = plan->band_counts[plan->rank];
+    plan->band = (double*)allocBuffer(n * width * sizeof(double));
+    plan->band_T = (double*)allocBuffer(n * width * sizeof(double));
+
+    // Derived data types definition: a column of a row of blocks in M and in the band, a row of a column of blocks in T
+    MPI_Datatype block_type;
+    for (int last = 0; last < 2; last++) {
+        int rows = last ? n - (plan->blocks_per_row - 1) * bs : bs;
+
+        MPI_Type_vector(rows, 1, n, MPI_DOUBLE, &block_type);
+        MPI_Type_create_resized(block_type, 0, sizeof(double), &plan->block_send_type[last]);
+        MPI_Type_commit(&plan->block_send_type[last]);
+        MPI_Type_free(&block_type);
+
+        MPI_Type_vector(rows, 1, width > 0 ? width : 1, MPI_DOUBLE, &block_type);
+        MPI_Type_create_resized(block_type, 0, sizeof(double), &plan->block_partition_type[last]);
+        MPI_Type_commit(&plan->block_partition_type[last]);
+        MPI_Type_free(&block_type);
+
+        MPI_Type_contiguous(rows, MPI_DOUBLE, &block_type);
+        MPI_Type_create_resized(block_type, 0, sizeof(double) * n, &plan->block_recv_type[last]);
+        MPI_Type_commit(&plan->block_recv_type[last]);
+        MPI_Type_free(&block_type);
+    }
+
+    return plan;
+}
 
-#define BLOCK_SIZE 2
+// Returns the cached plan of the shape, creating it at the first call
+BlockPlan* blockPlanCreate(int n, int bs) {
+    PlanKey key = {n, 0, bs, MPI_DOUBLE};
+    MPI_Comm_size(MPI_COMM_WORLD, &key.processes);
 
-MPI_Datatype block_type, block_send_type, block_partition_type, block_recv_type;
+    BlockPlan* plan = (BlockPlan*)planCacheFind(key);
+    if (plan != NULL) return plan;
 
-void matTransposeBlockMPI(double* M, double* T, double* blocks, int n, int rank, int size, double* t) {
-    int chunk = n / size;
-    int bs = chunk > BLOCK_SIZE ? BLOCK_SIZE : chunk;
-    int total_blocks = n * n / (bs * bs);
-    int blocks_per_process = total_blocks / size;
-    int blocks_per_row = n / bs;
-    int blocks_per_row_per_process = blocks_per_row / size;
+    plan = blockPlanBuild(key);
+    planCacheInsert(key, plan, blockPlanDestroy);
 
-    // Blocks partitioning
+    return plan;
+}
+
+void matTransposeBlockMPI(BlockPlan* plan, double* M, double* T, double* t) {
+    int n = plan->key.n;
+    int bs = plan->key.block_size;
+    int blocks_per_row = plan->blocks_per_row;
+    int width = plan->width;
+
+    // Blocks partitioning: every row of blocks is scattered by columns, each process receives its band of blocks
     for (int i = 0; i < blocks_per_row; i++) {
-        MPI_Scatter(M + i * n * bs, blocks_per_row_per_process, block_send_type,
-                    blocks + i * bs * blocks_per_row_per_process, blocks_per_row_per_process, block_partition_type,
-                    0, MPI_COMM_WORLD);
+        int last = i == blocks_per_row - 1;
+        int rows = bs < n - i * bs ? bs : n - i * bs;
+        double start = MPI_Wtime();
+        MPI_Scatterv(M + i * bs * n, plan->band_counts, plan->band_displs, plan->block_send_type[last],
+                     plan->band + i * bs * width, width, plan->block_partition_type[last],
+                     0, plan->comm);
+        traceSpan("MPI_Scatterv", i, start, MPI_Wtime(), (long)rows * width * sizeof(double));
     }
 
     double t1 = MPI_Wtime();
+    countersStart();
 
-    // Blocks transposition
-    for (int bn = 0; bn < blocks_per_process; bn++) {
-        double* block = blocks + bn * bs;
-        for (int i = 0; i < bs; i++) {
-            for (int j = 0; j < i; j++) {
-                double temp = block[i * bs * blocks_per_process + j];
-                block[i * bs * blocks_per_process + j] = block[j * bs + i];
-                block[j * bs + i] = temp;
-            }
-        }
+    // Blocks transposition: the blocks of every row, remainder blocks included, become a column of blocks of T
+    for (int i = 0; i < blocks_per_row; i++) {
+        int rows = bs < n - i * bs ? bs : n - i * bs;
+        tile_kernel(plan->band + i * bs * width, plan->band_T + i * bs, rows, width, width, n);
     }
 
+    countersStop();
     double t2 = MPI_Wtime();
     *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
 
-    // Blocks gathering
+    // Blocks gathering (all the blocks have already left M, so T can alias M for the in-place transpose)
     for (int i = 0; i < blocks_per_row; i++) {
-        MPI_Gather(blocks + i * bs * blocks_per_row_per_process, blocks_per_row_per_process, block_partition_type,
-                   T + i * bs, blocks_per_row_per_process, block_recv_type,
-                   0, MPI_COMM_WORLD);
+        int last = i == blocks_per_row - 1;
+        int rows = bs < n - i * bs ? bs : n - i * bs;
+        double start = MPI_Wtime();
+        MPI_Gatherv(plan->band_T + i * bs, width, plan->block_recv_type[last],
+                    T + i * bs, plan->band_counts, plan->band_displs, plan->block_recv_type[last],
+                    0, plan->comm);
+        traceSpan("MPI_Gatherv", i, start, MPI_Wtime(), (long)rows * width * sizeof(double));
     }
 }
 
-// The attribute is necessary to avoid the compiler optimization on the repetitions loops
-int __attribute__((optimize("O0"))) main(int argc, char** argv) {
+// Matrices of a tuning run
+typedef struct {
+    double *M, *T;
+    int n;
+} TuneArgs;
+
+// Each candidate gets a plan of its own, destroyed after the run, so that the bands of the losers are not kept in the cache
+double tuneRun(int bs, void* arg) {
+    TuneArgs* args = (TuneArgs*)arg;
+    PlanKey key = {args->n, 0, bs, MPI_DOUBLE};
+    MPI_Comm_size(MPI_COMM_WORLD, &key.processes);
+    BlockPlan* plan = blockPlanBuild(key);
+    double t = 0, seconds;
+
+    MPI_Barrier(plan->comm);
+    double t1 = MPI_Wtime();
+    for (int i = 0; i < TUNE_REPETITIONS; i++) matTransposeBlockMPI(plan, args->M, args->T, &t);
+    double t2 = (MPI_Wtime() - t1) / TUNE_REPETITIONS;
+
+    // every process takes the same decision on the slowest time
+    MPI_Allreduce(&t2, &seconds, 1, MPI_DOUBLE, MPI_MAX, plan->comm);
+    blockPlanDestroy(plan);
+    return seconds;
+}
+
+int main(int argc, char** argv) {
 #ifndef MPI_VERSION
     printf("Error: compile with MPI support!\n");
     return -1;
 #endif
 
-    int dim = 0;
     int rep = 0;
     if (argc < 2) {
-        printf("Correct usage: program-name [M dimension as exponent of 2] [number of repetitions (default 5)]\n");
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [inplace] [bs=block size] [tune] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
         return 1;
     } else if (argc == 2) {
-        dim = atoi(argv[1]);
         rep = 500;
     } else {
-        dim = atoi(argv[1]);
         rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
     }
 
-    unsigned int n = pow(2, dim);
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    bool in_place = getOption(argc, argv, "inplace") != NULL;
 
     // Setup MPI
     int size, rank;
@@ -85,95 +209,107 @@ int __attribute__((optimize("O0"))) main(int argc, char** argv) {
     if (rank == 0) {
         printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
         printf("Matrix dimension: %d\n", n);
-        printf("Repetitions: %d\n\n", rep);
-    }
-
-    if (n % size != 0) {
-        if (rank == 0) {
-            printf("Error: the matrix dimension must be divisible by the number of processes!\n");
-        }
-
-        MPI_Finalize();
-        return -1;
+        printf("Repetitions: %d\n", rep);
+        printf("In-place: %s\n\n", in_place ? "true" : "false");
     }
 
     // Variables declaration
-    double ts1, te1, t1;  // temp time variables
-    double t1m, t1e;      // execution times
-    double* M;            // input matrix
-    double* T;            // transposed matrix
-    double* blocks;       // temporary blocks
-
-    int bs = n / size > BLOCK_SIZE ? BLOCK_SIZE : n / size;
-    int blocks_per_process = n * n / (bs * bs) / size;
-
-    blocks = (double*)malloc(bs * bs * sizeof(double) * blocks_per_process);
+    double t1 = 0;      // effective time
+    double t1m, t1e;    // execution times
+    BenchmarkStats s1;  // statistics of the repetitions
+    CounterValues c1;   // hardware counters of the repetitions
+    double* M = NULL;   // input matrix
+    double* T = NULL;   // transposed matrix (aliases M in-place)
 
     // Matrices allocation
     if (rank == 0) {
-        if (initMatrices(&M, &T, n) == -1) {
+        if (allocMatrices(&M, in_place ? NULL : &T, n) == -1) {
             printf("Error in allocating matrices!\n\n");
             MPI_Finalize();
             return -1;
         }
+        if (in_place) T = M;
     }
+    fillMatrixDistributed(M, n, MPI_COMM_WORLD);
+
+    tile_kernel = selectTileKernel();
+
+    // Block size: bs= option, otherwise tuned on this machine, otherwise from the wisdom file of this CPU read by rank 0
+    const char* code = in_place ? CODE_IN_PLACE : CODE;
+    int bs;
+    if (getOption(argc, argv, "bs") != NULL && atoi(getOption(argc, argv, "bs")) > 0) {
+        bs = atoi(getOption(argc, argv, "bs"));
+        bs = bs < (int)n ? bs : (int)n;
+    } else if (getOption(argc, argv, "tune") != NULL) {
+        TuneArgs args = {M, T, n};
+        bs = tuneBlockSize(code, n, size, rank == 0, tuneRun, &args);
+    } else {
+        if (rank == 0) bs = wisdomBlockSize(code, n, size, BLOCK_SIZE);
+        MPI_Bcast(&bs, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    if (rank == 0) printf("Block size: %d\n\n", bs);
 
-    // Derived data types definition
-    MPI_Type_vector(bs, bs, n, MPI_DOUBLE, &block_type);
-    MPI_Type_commit(&block_type);
-
-    MPI_Type_create_resized(block_type, 0, sizeof(double) * bs, &block_send_type);
-    MPI_Type_commit(&block_send_type);
-
-    MPI_Type_vector(bs, bs, bs * blocks_per_process, MPI_DOUBLE, &block_type);
-    MPI_Type_commit(&block_type);
-
-    MPI_Type_create_resized(block_type, 0, sizeof(double) * bs, &block_partition_type);
-    MPI_Type_commit(&block_partition_type);
-
-    MPI_Type_vector(bs, bs, n, MPI_DOUBLE, &block_type);
-    MPI_Type_commit(&block_type);
+    // Plan creation: data types, partitions and bands are set up once, outside the timed repetitions
+    BlockPlan* plan = blockPlanCreate(n, bs);
 
-    MPI_Type_create_resized(block_type, 0, sizeof(double) * bs * n, &block_recv_type);
-    MPI_Type_commit(&block_recv_type);
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
 
-    // Parallel execution
     MPI_Barrier(MPI_COMM_WORLD);
 
-    ts1 = MPI_Wtime();
-    for (int i = 0; i < rep; i++) matTransposeBlockMPI(M, T, blocks, n, rank, size, &t1);
-    te1 = MPI_Wtime();
+    for (int i = 0; i < bench.warmup; i++) matTransposeBlockMPI(plan, M, T, &t1);
+    t1 = 0;
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        matTransposeBlockMPI(plan, M, T, &t1);
+        benchmarkStop(&bench, i);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
     // Results printing and saving
     MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
     if (rank == 0) {
-        t1m = (te1 - ts1) / rep;
-        t1e = t1 / rep;
+        t1m = s1.mean;
+        t1e = t1e / rep;
 
         printf("Parallel execution (message passing included and excluded):\n");
-        printf("matTransposeBlockMPI: %.9f\t%.9f seconds\n\n", t1m, t1e);
+        printf("matTransposeBlockMPI: %.9f\t%.9f seconds\n", t1m, t1e);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("\n");
 
-        testResultsBlock(M, T, n);
+        if (in_place) testResultsInPlace(M, n, rep + bench.warmup);
 
-        if (saveResultsMPI(CODE, n, size, 0, 0, t1m, t1e) == -1) {
+        if (saveResultsMPI(in_place ? CODE_IN_PLACE : CODE, n, size, 1, NULL, 0, &s1, t1e, NULL, &c1) == -1) {
             printf("Error in saving results!\n\n");
         }
     }
 
+    // Transpose checked slab-wise on every rank
+    if (!in_place) testResultsScattered(T, n, MPI_COMM_WORLD);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
     // Matrices deallocation
-    if (M != NULL && rank == 0) free(M);
-    if (T != NULL && rank == 0) free(T);
-    if (blocks != NULL) free(blocks);
+    if (M != NULL && rank == 0) freeBuffer(M);
+    if (T != NULL && rank == 0 && !in_place) freeBuffer(T);
 
-    // Derived data types deallocation
-    MPI_Type_free(&block_type);
-    MPI_Type_free(&block_send_type);
-    MPI_Type_free(&block_partition_type);
-    MPI_Type_free(&block_recv_type);
+    // Plans deallocation
+    planCacheClear();
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
 
     MPI_Finalize();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -6,43 +6,141 @@
 #include <time.h>
 
 #include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
 
 #define CODE "MC"
 
-MPI_Datatype type_row_n, type_column, type_column_n, type_column_chunk;
+EqualKernel equal_kernel = checkEqualScalar;  // selected at runtime by CPUID
+
+// Transpose plan, created once per shape and executed by every call with no setup: it owns the communicator, the
+// committed data types, the partitions and the temporary buffers
+typedef struct {
+    PlanKey key;
+    MPI_Comm comm;
+    int rank, size;
+    MPI_Datatype type_row_n, type_column_n, type_column_chunk;
+    int *row_counts, *row_displs;            // balanced partition of the rows, in rows (or columns) of M
+    int *triangle_counts, *triangle_displs;  // equal-area partition of the rows, in rows (or columns) of M
+    double *temp_rows, *temp_columns;        // temporary matrix
+} CustomPlan;
+
+void customPlanDestroy(void* p) {
+    CustomPlan* plan = (CustomPlan*)p;
+
+    MPI_Type_free(&plan->type_row_n);
+    MPI_Type_free(&plan->type_column_n);
+    MPI_Type_free(&plan->type_column_chunk);
+    MPI_Comm_free(&plan->comm);
+
+    free(plan->row_counts);
+    free(plan->row_displs);
+    free(plan->triangle_counts);
+    free(plan->triangle_displs);
+    freeBuffer(plan->temp_rows);
+    freeBuffer(plan->temp_columns);
+    free(plan);
+}
+
+// Returns the cached plan of the shape, creating it at the first call
+CustomPlan* customPlanCreate(int n, MPI_Datatype dtype) {
+    PlanKey key = {n, 0, 0, dtype};
+    MPI_Comm_size(MPI_COMM_WORLD, &key.processes);
+
+    CustomPlan* plan = (CustomPlan*)planCacheFind(key);
+    if (plan != NULL) return plan;
+
+    plan = (CustomPlan*)malloc(sizeof(CustomPlan));
+    plan->key = key;
+    MPI_Comm_dup(MPI_COMM_WORLD, &plan->comm);
+    MPI_Comm_size(plan->comm, &plan->size);
+    MPI_Comm_rank(plan->comm, &plan->rank);
+
+    int element;
+    int chunk = partitionRows(n, plan->size, plan->rank);
+    MPI_Type_size(dtype, &element);
+
+    // Derived data types definition
+    MPI_Datatype type_column;
+
+    MPI_Type_contiguous(n, dtype, &plan->type_row_n);
+    MPI_Type_commit(&plan->type_row_n);
+
+    MPI_Type_vector(n, 1, n, dtype, &type_column);
+    MPI_Type_create_resized(type_column, 0, element, &plan->type_column_n);
+    MPI_Type_commit(&plan->type_column_n);
+    MPI_Type_free(&type_column);
+
+    MPI_Type_vector(n, 1, chunk > 0 ? chunk : 1, dtype, &type_column);
+    MPI_Type_create_resized(type_column, 0, element, &plan->type_column_chunk);
+    MPI_Type_commit(&plan->type_column_chunk);
+    MPI_Type_free(&type_column);
+
+    // Partitions and buffers
+    plan->row_counts = (int*)malloc(plan->size * sizeof(int));
+    plan->row_displs = (int*)malloc(plan->size * sizeof(int));
+    plan->triangle_counts = (int*)malloc(plan->size * sizeof(int));
+    plan->triangle_displs = (int*)malloc(plan->size * sizeof(int));
+    partitionCounts(n, plan->size, 1, plan->row_counts, plan->row_displs);
+    triangleCounts(n, plan->size, 1, plan->triangle_counts, plan->triangle_displs);
+
+    int max_chunk = chunk > triangleRows(n, plan->size, plan->rank) ? chunk : triangleRows(n, plan->size, plan->rank);
+    plan->temp_rows = (double*)allocBuffer(max_chunk * n * element);
+    plan->temp_columns = (double*)allocBuffer(max_chunk * n * element);
+
+    planCacheInsert(key, plan, customPlanDestroy);
+
+    return plan;
+}
 
-bool checkSymMPI(double* M, double* temp_rows, double* temp_columns, int n, int rank, int size, double* t) {
-    int chunk = n / size;
-    bool local_check = true;
-    bool check = true;
+bool checkSymMPI(CustomPlan* plan, double* M, double* t) {
+    int n = plan->key.n;
+    int row_start = triangleStart(n, plan->size, plan->rank);
+    int chunk = triangleRows(n, plan->size, plan->rank);
+    int stripes = triangleStripes(n, plan->size);
+    double* temp_rows = plan->temp_rows;
+    double* temp_columns = plan->temp_columns;
+    SymmetryFlag flag;
 
-    MPI_Scatter(M, chunk, type_row_n, temp_rows, chunk, type_row_n, 0, MPI_COMM_WORLD);
-    MPI_Scatter(M, chunk, type_column_n, temp_columns, chunk, type_row_n, 0, MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    MPI_Scatterv(M, plan->triangle_counts, plan->triangle_displs, plan->type_row_n, temp_rows, chunk, plan->type_row_n, 0, plan->comm);
+    MPI_Scatterv(M, plan->triangle_counts, plan->triangle_displs, plan->type_column_n, temp_columns, chunk, plan->type_row_n, 0, plan->comm);
+    traceSpan("MPI_Scatterv", -1, start, MPI_Wtime(), 2L * n * chunk * sizeof(double));
 
     double t1 = MPI_Wtime();
+    countersStart();
 
-    for (int i = 0; i < chunk; i++) {
-        for (int j = 0; j < i; j++) {
-            if (fabs(temp_rows[i * n + j] - temp_columns[i * n + j]) > EPSILON) {
-                local_check = false;
-            }
+    symmetryFlagInit(&flag);
+    for (int s = 0; s < stripes; s++) {
+        if (!symmetryFlagPoll(&flag, plan->comm)) break;
+
+        // row and column of the same global index are compared up to the diagonal
+        int end = triangleSplit(row_start, row_start + chunk, s + 1, stripes) - row_start;
+        for (int k = triangleSplit(row_start, row_start + chunk, s, stripes) - row_start; k < end && flag.local; k++) {
+            flag.local = equal_kernel(temp_rows + (size_t)k * n, temp_columns + (size_t)k * n, row_start + k, EPSILON);
         }
     }
 
+    countersStop();
     double t2 = MPI_Wtime();
     *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
 
-    MPI_Reduce(&local_check, &check, 1, MPI_C_BOOL, MPI_LAND, 0, MPI_COMM_WORLD);
-
-    return check;
+    return symmetryFlagResult(&flag, plan->comm);
 }
 
-void matTransposeMPI(double* M, double* T, double* temp_rows, double* temp_columns, int n, int rank, int size, double* t) {
-    int chunk = n / size;
+void matTransposeMPI(CustomPlan* plan, double* M, double* T, double* t) {
+    int n = plan->key.n;
+    int chunk = partitionRows(n, plan->size, plan->rank);
+    double* temp_rows = plan->temp_rows;
+    double* temp_columns = plan->temp_columns;
 
-    MPI_Scatter(M, chunk, type_row_n, temp_rows, chunk, type_row_n, 0, MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    MPI_Scatterv(M, plan->row_counts, plan->row_displs, plan->type_row_n, temp_rows, chunk, plan->type_row_n, 0, plan->comm);
+    traceSpan("MPI_Scatterv", -1, start, MPI_Wtime(), (long)n * chunk * sizeof(double));
 
     double t1 = MPI_Wtime();
+    countersStart();
 
     for (int i = 0; i < chunk; i++) {
         for (int j = 0; j < n; j++) {
@@ -50,33 +148,35 @@ void matTransposeMPI(double* M, double* T, double* temp_rows, double* temp_colum
         }
     }
 
+    countersStop();
     double t2 = MPI_Wtime();
     *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
 
-    MPI_Gather(temp_columns, chunk, type_column_chunk, T, chunk, type_column_n, 0, MPI_COMM_WORLD);
+    start = MPI_Wtime();
+    MPI_Gatherv(temp_columns, chunk, plan->type_column_chunk, T, plan->row_counts, plan->row_displs, plan->type_column_n, 0, plan->comm);
+    traceSpan("MPI_Gatherv", -1, start, MPI_Wtime(), (long)n * chunk * sizeof(double));
 }
 
-// The attribute is necessary to avoid the compiler optimization on the repetitions loops
-int __attribute__((optimize("O0"))) main(int argc, char** argv) {
+int main(int argc, char** argv) {
 #ifndef MPI_VERSION
     printf("Error: compile with MPI support!\n");
     return -1;
 #endif
 
-    int dim = 0;
     int rep = 0;
     if (argc < 2) {
-        printf("Correct usage: program-name [M dimension as exponent of 2] [number of repetitions (default 5)]\n");
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [input=file] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
         return 1;
     } else if (argc == 2) {
-        dim = atoi(argv[1]);
         rep = 500;
     } else {
-        dim = atoi(argv[1]);
         rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
     }
 
-    unsigned int n = pow(2, dim);
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
 
     // Setup MPI
     int size, rank;
@@ -85,6 +185,14 @@ int __attribute__((optimize("O0"))) main(int argc, char** argv) {
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+    // The dimension of the input file replaces [n]
+    const char* input_name = getOption(argc, argv, "input");
+    if (input_name != NULL && (int)(n = readMatrixDimensionMPI(input_name, MPI_COMM_WORLD)) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Finalize();
+        return -1;
+    }
+
     if (rank == 0) {
         printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
         printf("Matrix dimension: %d\n", n);
@@ -92,63 +200,66 @@ int __attribute__((optimize("O0"))) main(int argc, char** argv) {
         printf("Processes: %d\n\n", size);
     }
 
-    if (n % size != 0) {
-        if (rank == 0) {
-            printf("Error: the matrix dimension must be divisible by the number of processes!\n");
-        }
-
-        MPI_Finalize();
-        return -1;
-    }
-
     // Variables declaration
-    double ts1, ts2, te1, te2, t1, t2;  // temp time variables
-    double t1m, t1e, t2m, t2e;          // execution times
-    bool symmetric = false;             // symmetry check
-    double* M;                          // input matrix
-    double* T;                          // transposed matrix
-    double *temp_rows, *temp_columns;   // temporary matrix
+    double t1 = 0, t2 = 0;      // effective times
+    double t1m, t1e, t2m, t2e;  // execution times
+    BenchmarkStats s1, s2;      // statistics of the repetitions
+    CounterValues c1, c2;       // hardware counters of the repetitions
+    bool symmetric = false;     // symmetry check
+    double* M = NULL;           // input matrix
+    double* T = NULL;           // transposed matrix
 
     // Matrices allocation
     if (rank == 0) {
-        if (initMatrices(&M, &T, n) == -1) {
+        if (allocMatrices(&M, &T, n) == -1) {
             printf("Error in allocating matrices!\n\n");
             MPI_Finalize();
             return -1;
         }
     }
+    if (input_name == NULL) {
+        fillMatrixDistributed(M, n, MPI_COMM_WORLD);
+    } else if (readMatrixDistributed(input_name, M, n, MPI_COMM_WORLD) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    // Derived data types definition
-    MPI_Type_contiguous(n, MPI_DOUBLE, &type_row_n);
-    MPI_Type_commit(&type_row_n);
-
-    MPI_Type_vector(n, 1, n, MPI_DOUBLE, &type_column);
-    MPI_Type_commit(&type_column);
-
-    MPI_Type_create_resized(type_column, 0, 1 * sizeof(double), &type_column_n);
-    MPI_Type_commit(&type_column_n);
-
-    MPI_Type_vector(n, 1, n / size, MPI_DOUBLE, &type_column);
-    MPI_Type_commit(&type_column);
+    // Plan creation: data types, partitions and buffers are set up once, outside the timed repetitions
+    CustomPlan* plan = customPlanCreate(n, MPI_DOUBLE);
 
-    MPI_Type_create_resized(type_column, 0, 1 * sizeof(double), &type_column_chunk);
-    MPI_Type_commit(&type_column_chunk);
+    equal_kernel = selectEqualKernel();
 
-    // Parallel execution
-    temp_rows = (double*)malloc(n * n / size * sizeof(double));
-    temp_columns = (double*)malloc(n * n / size * sizeof(double));
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
-    ts1 = MPI_Wtime();
-    for (int i = 0; i < rep; i++) symmetric = checkSymMPI(M, temp_rows, temp_columns, n, rank, size, &t1);
-    te1 = MPI_Wtime();
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(plan, M, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(plan, M, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
-    ts2 = MPI_Wtime();
-    for (int i = 0; i < rep; i++) matTransposeMPI(M, T, temp_rows, temp_columns, n, rank, size, &t2);
-    te2 = MPI_Wtime();
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(plan, M, T, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(plan, M, T, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep, MPI_COMM_WORLD);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -156,33 +267,42 @@ int __attribute__((optimize("O0"))) main(int argc, char** argv) {
     MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
     MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
     if (rank == 0) {
-        t1m = (te1 - ts1) / rep;
-        t2m = (te2 - ts2) / rep;
-        t1e = t1 / rep;
-        t2e = t2 / rep;
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
 
         printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
         printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
-        printf("matTransposeMPI: %.9f\t%.9f seconds\n\n", t2m, t2e);
-
-        testResults(M, T, n);
-
-        if (saveResultsMPI(CODE, n, size, t1m, t1e, t2m, t2e) == -1) {
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, size, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
             printf("Error in saving results!\n\n");
         }
     }
 
+    // Transpose checked slab-wise on every rank, against the regenerated input of a generated matrix only
+    if (input_name == NULL) testResultsScattered(T, n, MPI_COMM_WORLD);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
     // Matrices deallocation
-    if (M != NULL && rank == 0) free(M);
-    if (T != NULL && rank == 0) free(T);
-    if (temp_rows != NULL) free(temp_rows);
-    if (temp_columns != NULL) free(temp_columns);
+    if (M != NULL && rank == 0) freeBuffer(M);
+    if (T != NULL && rank == 0) freeBuffer(T);
 
-    // Derived data types deallocation
-    MPI_Type_free(&type_row_n);
-    MPI_Type_free(&type_column);
-    MPI_Type_free(&type_column_n);
-    MPI_Type_free(&type_column_chunk);
+    // Plans deallocation
+    planCacheClear();
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
 
     MPI_Finalize();
 
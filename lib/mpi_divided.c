@@ -6,43 +6,62 @@
 #include <time.h>
 
 #include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
 
 #define CODE "MD"
 
-bool checkSymMPI(double* M, double* temp_rows, double* temp_columns, int n, int rank, int size, double* t) {
-    int chunk = n / size;
-    bool local_check = true;
-    bool check = true;
+SymKernel sym_kernel = checkTileSymScalar;  // selected at runtime by CPUID
+
+int *slab_counts, *slab_displs;                    // balanced partition of the rows, in elements of M
+int *row_counts, *row_displs;                      // balanced partition of the rows, in elements of a row
+int *triangle_slab_counts, *triangle_slab_displs;  // equal-area partition of the rows, in elements of M
+int *triangle_row_counts, *triangle_row_displs;    // equal-area partition of the rows, in elements of a row
 
-    MPI_Scatter(M, n * chunk, MPI_DOUBLE, temp_rows, n * chunk, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+bool checkSymMPI(double* M, double* temp_rows, double* temp_columns, int n, int rank, int size, double* t) {
+    int row_start = triangleStart(n, size, rank);
+    int chunk = triangleRows(n, size, rank);
+    int stripes = triangleStripes(n, size);
+    SymmetryFlag flag;
+
+    double start = MPI_Wtime();
+    MPI_Scatterv(M, triangle_slab_counts, triangle_slab_displs, MPI_DOUBLE, temp_rows, n * chunk, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    traceSpan("MPI_Scatterv", -1, start, MPI_Wtime(), (long)n * chunk * sizeof(double));
     for (int i = 0; i < n; i++) {
-        MPI_Scatter(M + i * n, chunk, MPI_DOUBLE, temp_columns + i * chunk, chunk, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        start = MPI_Wtime();
+        MPI_Scatterv(M + i * n, triangle_row_counts, triangle_row_displs, MPI_DOUBLE, temp_columns + i * chunk, chunk, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        traceSpan("MPI_Scatterv", i, start, MPI_Wtime(), chunk * sizeof(double));
     }
 
     double t1 = MPI_Wtime();
+    countersStart();
 
-    for (int i = 0; i < chunk; i++) {
-        for (int j = 0; j < rank * chunk + i; j++) {
-            if (fabs(temp_rows[i * n + j] - temp_columns[j * chunk + i]) > EPSILON) {
-                local_check = false;
-            }
-        }
+    symmetryFlagInit(&flag);
+    for (int s = 0; s < stripes; s++) {
+        if (!symmetryFlagPoll(&flag, MPI_COMM_WORLD)) break;
+
+        int i = triangleSplit(row_start, row_start + chunk, s, stripes) - row_start;
+        int rows = triangleSplit(row_start, row_start + chunk, s + 1, stripes) - row_start - i;
+        if (flag.local && rows > 0) flag.local = sym_kernel(temp_rows + (size_t)i * n, temp_columns + i, rows, row_start + i + rows, n, chunk, EPSILON);
     }
 
+    countersStop();
     double t2 = MPI_Wtime();
     *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
 
-    MPI_Reduce(&local_check, &check, 1, MPI_C_BOOL, MPI_LAND, 0, MPI_COMM_WORLD);
-
-    return check;
+    return symmetryFlagResult(&flag, MPI_COMM_WORLD);
 }
 
 void matTransposeMPI(double* M, double* T, double* temp_rows, double* temp_columns, int n, int rank, int size, double* t) {
-    int chunk = n / size;
+    int chunk = partitionRows(n, size, rank);
 
-    MPI_Scatter(M, n * chunk, MPI_DOUBLE, temp_rows, n * chunk, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    MPI_Scatterv(M, slab_counts, slab_displs, MPI_DOUBLE, temp_rows, n * chunk, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    traceSpan("MPI_Scatterv", -1, start, MPI_Wtime(), (long)n * chunk * sizeof(double));
 
     double t1 = MPI_Wtime();
+    countersStart();
 
     for (int i = 0; i < chunk; i++) {
         for (int j = 0; j < n; j++) {
@@ -50,35 +69,37 @@ void matTransposeMPI(double* M, double* T, double* temp_rows, double* temp_colum
         }
     }
 
+    countersStop();
     double t2 = MPI_Wtime();
     *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
 
     for (int i = 0; i < n; i++) {
-        MPI_Gather(temp_columns + i * chunk, chunk, MPI_DOUBLE, T + i * n, chunk, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        MPI_Gatherv(temp_columns + i * chunk, chunk, MPI_DOUBLE, T + i * n, row_counts, row_displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        traceSpan("MPI_Gatherv", i, start, MPI_Wtime(), chunk * sizeof(double));
     }
 }
 
-// The attribute is necessary to avoid the compiler optimization on the repetitions loops
-int __attribute__((optimize("O0"))) main(int argc, char** argv) {
+int main(int argc, char** argv) {
 #ifndef MPI_VERSION
     printf("Error: compile with MPI support!\n");
     return -1;
 #endif
 
-    int dim = 0;
     int rep = 0;
     if (argc < 2) {
-        printf("Correct usage: program-name [M dimension as exponent of 2] [number of repetitions (default 5)]\n");
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [input=file] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
         return 1;
     } else if (argc == 2) {
-        dim = atoi(argv[1]);
         rep = 500;
     } else {
-        dim = atoi(argv[1]);
         rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
     }
 
-    unsigned int n = pow(2, dim);
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
 
     // Setup MPI
     int size, rank;
@@ -87,6 +108,14 @@ int __attribute__((optimize("O0"))) main(int argc, char** argv) {
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+    // The dimension of the input file replaces [n]
+    const char* input_name = getOption(argc, argv, "input");
+    if (input_name != NULL && (int)(n = readMatrixDimensionMPI(input_name, MPI_COMM_WORLD)) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Finalize();
+        return -1;
+    }
+
     if (rank == 0) {
         printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
         printf("Matrix dimension: %d\n", n);
@@ -94,47 +123,80 @@ int __attribute__((optimize("O0"))) main(int argc, char** argv) {
         printf("Processes: %d\n\n", size);
     }
 
-    if (n % size != 0) {
-        if (rank == 0) {
-            printf("Error: the matrix dimension must be divisible by the number of processes!\n");
-        }
-
-        MPI_Finalize();
-        return -1;
-    }
-
     // Variables declaration
-    double ts1, ts2, te1, te2, t1, t2;  // temp time variables
-    double t1m, t1e, t2m, t2e;          // execution times
-    bool symmetric = false;             // symmetry check
-    double* M;                          // input matrix
-    double* T;                          // transposed matrix
-    double *temp_rows, *temp_columns;   // temporary matrix
+    double t1 = 0, t2 = 0;             // effective times
+    double t1m, t1e, t2m, t2e;         // execution times
+    BenchmarkStats s1, s2;             // statistics of the repetitions
+    CounterValues c1, c2;              // hardware counters of the repetitions
+    bool symmetric = false;            // symmetry check
+    double* M = NULL;                  // input matrix
+    double* T = NULL;                  // transposed matrix
+    double *temp_rows, *temp_columns;  // temporary matrix
 
     // Matrices allocation
     if (rank == 0) {
-        if (initMatrices(&M, &T, n) == -1) {
+        if (allocMatrices(&M, &T, n) == -1) {
             printf("Error in allocating matrices!\n\n");
             MPI_Finalize();
             return -1;
         }
     }
+    if (input_name == NULL) {
+        fillMatrixDistributed(M, n, MPI_COMM_WORLD);
+    } else if (readMatrixDistributed(input_name, M, n, MPI_COMM_WORLD) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    // Parallel execution
-    temp_rows = (double*)malloc(n * n / size * sizeof(double));
-    temp_columns = (double*)malloc(n * n / size * sizeof(double));
+    sym_kernel = selectSymKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
+
+    int max_chunk = partitionRows(n, size, rank) > triangleRows(n, size, rank) ? partitionRows(n, size, rank) : triangleRows(n, size, rank);
+    temp_rows = (double*)allocBuffer(max_chunk * n * sizeof(double));
+    temp_columns = (double*)allocBuffer(max_chunk * n * sizeof(double));
+    slab_counts = (int*)malloc(size * sizeof(int));
+    slab_displs = (int*)malloc(size * sizeof(int));
+    row_counts = (int*)malloc(size * sizeof(int));
+    row_displs = (int*)malloc(size * sizeof(int));
+    partitionCounts(n, size, n, slab_counts, slab_displs);
+    partitionCounts(n, size, 1, row_counts, row_displs);
+    triangle_slab_counts = (int*)malloc(size * sizeof(int));
+    triangle_slab_displs = (int*)malloc(size * sizeof(int));
+    triangle_row_counts = (int*)malloc(size * sizeof(int));
+    triangle_row_displs = (int*)malloc(size * sizeof(int));
+    triangleCounts(n, size, n, triangle_slab_counts, triangle_slab_displs);
+    triangleCounts(n, size, 1, triangle_row_counts, triangle_row_displs);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
-    ts1 = MPI_Wtime();
-    for (int j = 0; j < rep; j++) symmetric = checkSymMPI(M, temp_rows, temp_columns, n, rank, size, &t1);
-    te1 = MPI_Wtime();
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(M, temp_rows, temp_columns, n, rank, size, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(M, temp_rows, temp_columns, n, rank, size, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
-    ts2 = MPI_Wtime();
-    for (int j = 0; j < rep; j++) matTransposeMPI(M, T, temp_rows, temp_columns, n, rank, size, &t2);
-    te2 = MPI_Wtime();
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(M, T, temp_rows, temp_columns, n, rank, size, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(M, T, temp_rows, temp_columns, n, rank, size, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep, MPI_COMM_WORLD);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -142,27 +204,49 @@ int __attribute__((optimize("O0"))) main(int argc, char** argv) {
     MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
     MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
     if (rank == 0) {
-        t1m = (te1 - ts1) / rep;
-        t2m = (te2 - ts2) / rep;
-        t1e = t1 / rep;
-        t2e = t2 / rep;
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
 
         printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
         printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
-        printf("matTransposeMPI: %.9f\t%.9f seconds\n\n", t2m, t2e);
-
-        testResults(M, T, n);
-
-        if (saveResultsMPI(CODE, n, size, t1m, t1e, t2m, t2e) == -1) {
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, size, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
             printf("Error in saving results!\n\n");
         }
     }
 
+    // Transpose checked slab-wise on every rank, against the regenerated input of a generated matrix only
+    if (input_name == NULL) testResultsScattered(T, n, MPI_COMM_WORLD);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
     // Matrices deallocation
-    if (M != NULL && rank == 0) free(M);
-    if (T != NULL && rank == 0) free(T);
-    if (temp_rows != NULL) free(temp_rows);
-    if (temp_columns != NULL) free(temp_columns);
+    if (M != NULL && rank == 0) freeBuffer(M);
+    if (T != NULL && rank == 0) freeBuffer(T);
+    if (temp_rows != NULL) freeBuffer(temp_rows);
+    if (temp_columns != NULL) freeBuffer(temp_columns);
+    free(slab_counts);
+    free(slab_displs);
+    free(row_counts);
+    free(row_displs);
+    free(triangle_slab_counts);
+    free(triangle_slab_displs);
+    free(triangle_row_counts);
+    free(triangle_row_displs);
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
 
     MPI_Finalize();
 
@@ -0,0 +1,267 @@
+#ifndef MPI_FUNCTIONS_H
+#define MPI_FUNCTIONS_H
+
+#include <math.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "functions.h"
+#include "matrix_io.h"
+#include "trace.h"
+
+// Balanced partition of n rows among size ranks: the first n % size ranks own one row more
+static inline int partitionStart(int n, int size, int rank) {
+    return rank * (n / size) + (rank < n % size ? rank : n % size);
+}
+
+static inline int partitionRows(int n, int size, int rank) {
+    return n / size + (rank < n % size ? 1 : 0);
+}
+
+// Counts and displacements of the partition for the v-collectives, in units of unit elements per row
+static inline void partitionCounts(int n, int size, int unit, int* counts, int* displs) {
+    for (int k = 0; k < size; k++) {
+        counts[k] = partitionRows(n, size, k) * unit;
+        displs[k] = partitionStart(n, size, k) * unit;
+    }
+}
+
+// Row where the part of the rows [first, last) starts, when they are split in parts holding the same number of pairs of
+// the lower triangular part: row i holds i pairs, so the boundaries follow the square root of the area
+static inline int triangleSplit(int first, int last, int part, int parts) {
+    if (part >= parts) return last;
+
+    double a = (double)first * first;
+    double b = (double)last * last;
+    return (int)(sqrt(a + (b - a) * part / parts) + 0.5);
+}
+
+// Equal-area partition of the lower triangular part for the symmetry checks: rank r owns the rows from n * sqrt(r / size),
+// so every rank compares the same number of pairs, the first ranks many short rows and the last ones few long rows
+static inline int triangleStart(int n, int size, int rank) {
+    return triangleSplit(0, n, rank, size);
+}
+
+static inline int triangleRows(int n, int size, int rank) {
+    return triangleStart(n, size, rank + 1) - triangleStart(n, size, rank);
+}
+
+static inline void triangleCounts(int n, int size, int unit, int* counts, int* displs) {
+    for (int k = 0; k < size; k++) {
+        counts[k] = triangleRows(n, size, k) * unit;
+        displs[k] = triangleStart(n, size, k) * unit;
+    }
+}
+
+// Stripes scanned between two polls of the distributed symmetry flag, the same on every rank. The ranks wait for each
+// other at every poll, so the rows of each rank are split by triangleSplit in stripes of the same number of pairs: a
+// stripe of SYM_STRIPE rows on average on rank 0, of fewer and longer rows on the last ranks.
+static inline int triangleStripes(int n, int size) {
+    return (triangleRows(n, size, 0) + SYM_STRIPE - 1) / SYM_STRIPE;
+}
+
+// Distributed early exit of the symmetry check: after every stripe each rank contributes its partial result to a
+// non-blocking all-reduce, which completes while the next stripe is scanned. All the ranks must poll the same
+// number of times and stop together one stripe after any of them finds an asymmetric pair.
+typedef struct {
+    MPI_Request request;
+    bool local;    // result of the stripes scanned by this rank
+    bool sent;     // local result of the reduction in flight
+    bool global;   // result reduced over all the ranks
+    bool pending;  // reduction in flight
+} SymmetryFlag;
+
+static inline void symmetryFlagInit(SymmetryFlag* flag) {
+    flag->local = true;
+    flag->global = true;
+    flag->pending = false;
+}
+
+// Returns false when the reduction of the previous stripe found an asymmetric pair, otherwise starts the next one
+static inline bool symmetryFlagPoll(SymmetryFlag* flag, MPI_Comm comm) {
+    if (flag->pending) {
+        MPI_Wait(&flag->request, MPI_STATUS_IGNORE);
+        flag->pending = false;
+        if (!flag->global) return false;
+    }
+
+    flag->sent = flag->local;
+    MPI_Iallreduce(&flag->sent, &flag->global, 1, MPI_C_BOOL, MPI_LAND, comm, &flag->request);
+    flag->pending = true;
+
+    return true;
+}
+
+static inline bool symmetryFlagResult(SymmetryFlag* flag, MPI_Comm comm) {
+    if (flag->pending) {
+        MPI_Wait(&flag->request, MPI_STATUS_IGNORE);
+        flag->pending = false;
+    }
+    if (flag->global) {  // the last stripe is not reduced yet, same branch on every rank
+        MPI_Allreduce(&flag->local, &flag->global, 1, MPI_C_BOOL, MPI_LAND, comm);
+    }
+
+    return flag->global;
+}
+
+#define PLAN_CACHE_SIZE 8  // plans alive at the same time, the oldest one is destroyed first
+
+// Shape of a transpose plan: every call with the same key reuses the plan created by the first one
+typedef struct {
+    int n;
+    int processes;
+    int block_size;
+    MPI_Datatype dtype;
+} PlanKey;
+
+typedef struct {
+    PlanKey key;
+    void* plan;
+    void (*destroy)(void*);
+} PlanCacheEntry;
+
+static PlanCacheEntry plan_cache[PLAN_CACHE_SIZE];
+static int plan_cache_count = 0;
+
+static inline bool planKeyEqual(PlanKey a, PlanKey b) {
+    return a.n == b.n && a.processes == b.processes && a.block_size == b.block_size && a.dtype == b.dtype;
+}
+
+static inline void* planCacheFind(PlanKey key) {
+    for (int i = 0; i < plan_cache_count; i++) {
+        if (planKeyEqual(plan_cache[i].key, key)) return plan_cache[i].plan;
+    }
+    return NULL;
+}
+
+// The cache owns the plan from now on. Destroying a plan frees its communicator, a collective call: all the ranks
+// must create the same sequence of plans, so that they evict the same ones.
+static inline void planCacheInsert(PlanKey key, void* plan, void (*destroy)(void*)) {
+    if (plan_cache_count == PLAN_CACHE_SIZE) {
+        plan_cache[0].destroy(plan_cache[0].plan);
+        memmove(plan_cache, plan_cache + 1, (PLAN_CACHE_SIZE - 1) * sizeof(PlanCacheEntry));
+        plan_cache_count--;
+    }
+
+    plan_cache[plan_cache_count].key = key;
+    plan_cache[plan_cache_count].plan = plan;
+    plan_cache[plan_cache_count].destroy = destroy;
+    plan_cache_count++;
+}
+
+static inline void planCacheClear() {
+    for (int i = 0; i < plan_cache_count; i++) plan_cache[i].destroy(plan_cache[i].plan);
+    plan_cache_count = 0;
+}
+
+// Checks the row slab of the transpose and the symmetry result by regenerating the input entries on every rank, the
+// rows of the slab shared by the threads
+static inline void testResultsDistributed(const double* local_T, int n, int row_start, int rows, MPI_Comm comm) {
+    bool local_check = true;
+    bool local_transposed = true;
+    bool check, transposed;
+    int rank;
+
+    PARALLEL_FOR(schedule(static) reduction(& : local_check, local_transposed))
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < n; j++) {
+            double entry = randomEntry(matrix_seed, n, j, row_start + i);
+            local_check &= fabs(entry - randomEntry(matrix_seed, n, row_start + i, j)) <= EPSILON;
+            local_transposed &= local_T[(size_t)i * n + j] == entry;
+        }
+    }
+
+    MPI_Reduce(&local_check, &check, 1, MPI_C_BOOL, MPI_LAND, 0, comm);
+    MPI_Reduce(&local_transposed, &transposed, 1, MPI_C_BOOL, MPI_LAND, 0, comm);
+
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0) {
+        printf("Tested results: symmetry %s and transposed %s.\n\n", check ? "true" : "false", transposed ? "correct" : "incorrect");
+    }
+}
+
+// Same seed on every rank, so that the slabs belong to the same matrix
+static inline void initSeedDistributed(MPI_Comm comm) {
+    matrix_seed = time(0);
+    MPI_Bcast(&matrix_seed, 1, MPI_UNSIGNED, 0, comm);
+}
+
+// Generates the input of the programs that start from the whole matrix on rank 0: every rank generates its row slab
+// from the shared seed, then the slabs are gathered into M, significant on rank 0 only; collective over comm
+static inline void fillMatrixDistributed(double* M, int n, MPI_Comm comm) {
+    int rank, size;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    initSeedDistributed(comm);
+
+    int rows = partitionRows(n, size, rank);
+    double* slab = (double*)allocBuffer((size_t)rows * n * sizeof(double));
+    int* counts = (int*)malloc(size * sizeof(int));
+    int* displs = (int*)malloc(size * sizeof(int));
+    if (slab == NULL || counts == NULL || displs == NULL) MPI_Abort(comm, 1);
+
+    fillSlab(slab, n, partitionStart(n, size, rank), rows);
+    partitionCounts(n, size, n, counts, displs);
+    MPI_Gatherv(slab, rows * n, MPI_DOUBLE, M, counts, displs, MPI_DOUBLE, 0, comm);
+
+    freeBuffer(slab);
+    free(counts);
+    free(displs);
+}
+
+// Reads the input of the programs that start from the whole matrix on rank 0 from a matrix file: every process reads
+// its row slab with collective MPI-IO, then the slabs are gathered into M as in fillMatrixDistributed; collective over
+// comm, -1 on every process if the file is not a valid matrix of dimension n
+static inline int readMatrixDistributed(const char* name, double* M, int n, MPI_Comm comm) {
+    int rank, size;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int rows = partitionRows(n, size, rank);
+    double* slab = (double*)allocBuffer((size_t)rows * n * sizeof(double));
+    int* counts = (int*)malloc(size * sizeof(int));
+    int* displs = (int*)malloc(size * sizeof(int));
+    if (slab == NULL || counts == NULL || displs == NULL) MPI_Abort(comm, 1);
+
+    int result = readSlabMPI(name, slab, n, partitionStart(n, size, rank), rows, comm);
+    if (result == 0) {
+        partitionCounts(n, size, n, counts, displs);
+        MPI_Gatherv(slab, rows * n, MPI_DOUBLE, M, counts, displs, MPI_DOUBLE, 0, comm);
+    }
+
+    freeBuffer(slab);
+    free(counts);
+    free(displs);
+
+    return result;
+}
+
+// Checks the transpose held by rank 0 in parallel: its row slabs are scattered and every rank checks its own one
+// against the regenerated input, as testResultsDistributed; collective over comm
+static inline void testResultsScattered(const double* T, int n, MPI_Comm comm) {
+    int rank, size;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int rows = partitionRows(n, size, rank);
+    double* slab = (double*)allocBuffer((size_t)rows * n * sizeof(double));
+    int* counts = (int*)malloc(size * sizeof(int));
+    int* displs = (int*)malloc(size * sizeof(int));
+    if (slab == NULL || counts == NULL || displs == NULL) MPI_Abort(comm, 1);
+
+    partitionCounts(n, size, n, counts, displs);
+    MPI_Scatterv(T, counts, displs, MPI_DOUBLE, slab, rows * n, MPI_DOUBLE, 0, comm);
+    testResultsDistributed(slab, n, partitionStart(n, size, rank), rows, comm);
+
+    freeBuffer(slab);
+    free(counts);
+    free(displs);
+}
+
+#endif
@@ -0,0 +1,305 @@
+#include <math.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
+
+#define CODE "MG"
+
+#define DEFAULT_BLOCK_SIZE 64
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+SymKernel sym_kernel = checkTileSymScalar;     // selected at runtime by CPUID
+
+MPI_Comm grid_comm;            // q x q Cartesian grid of processes
+int q, prow, pcol;             // grid edge and coordinates of this process
+int partner;                   // process (pcol, prow), owner of the mirrored blocks
+int local_rows, local_cols;    // dimensions of the local array
+int stripes;                   // stripes of the symmetry check, the maximum over the grid
+
+// Number of rows (or columns) of an n x n matrix owned by grid coordinate p with block size nb (ScaLAPACK NUMROC)
+int numroc(int n, int nb, int p, int q) {
+    int blocks = n / nb;
+    int count = blocks / q * nb;
+    int extra = blocks % q;
+
+    if (p < extra) {
+        count += nb;
+    } else if (p == extra) {
+        count += n % nb;
+    }
+
+    return count;
+}
+
+// Global index of the local row (or column) l of grid coordinate p
+int globalIndex(int l, int nb, int p, int q) {
+    return (l / nb * q + p) * nb + l % nb;
+}
+
+// With a square grid and the same block size on both dimensions, the blocks mirrored to the local ones are all owned
+// by the partner (pcol, prow) at the transposed local positions: a single pairwise exchange replaces the all-to-all
+void exchangePartner(double* local_M, double* partner_M) {
+    if (partner == prow * q + pcol) return;  // diagonal process, its own mirror
+
+    double start = MPI_Wtime();
+    MPI_Sendrecv(local_M, local_rows * local_cols, MPI_DOUBLE, partner, 0,
+                 partner_M, local_rows * local_cols, MPI_DOUBLE, partner, 0, grid_comm, MPI_STATUS_IGNORE);
+    traceSpan("MPI_Sendrecv", -1, start, MPI_Wtime(), (long)local_rows * local_cols * sizeof(double));
+}
+
+bool checkSymMPI(double* local_M, double* partner_M, double* t) {
+    SymmetryFlag flag;
+    const double* mirror = prow == pcol ? local_M : partner_M;
+
+    exchangePartner(local_M, partner_M);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    // Processes under the diagonal of the grid compare their array with the transposed array of the partner
+    symmetryFlagInit(&flag);
+    for (int s = 0; s < stripes; s++) {
+        if (!symmetryFlagPoll(&flag, grid_comm)) break;
+
+        int i = s * SYM_STRIPE;
+        int rows = SYM_STRIPE < local_rows - i ? SYM_STRIPE : local_rows - i;
+        if (flag.local && prow >= pcol && rows > 0) {
+            flag.local = sym_kernel(local_M + i * local_cols, mirror + i, rows, local_cols, local_cols, local_rows, EPSILON);
+        }
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    return symmetryFlagResult(&flag, grid_comm);
+}
+
+void matTransposeMPI(double* local_M, double* local_T, double* partner_M, double* t) {
+    const double* mirror = prow == pcol ? local_M : partner_M;
+
+    exchangePartner(local_M, partner_M);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    // The partner array is local_cols x local_rows, its transpose is the local array of T
+    tile_kernel(mirror, local_T, local_cols, local_rows, local_rows, local_cols);
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+}
+
+// Checks the local array of T and the symmetry result by regenerating the input entries on every process
+void testResultsGrid(const double* local_T, int n, int nb) {
+    bool local_check = true;
+    bool local_transposed = true;
+    bool check, transposed;
+
+    for (int i = 0; i < local_rows; i++) {
+        int gi = globalIndex(i, nb, prow, q);
+        for (int j = 0; j < local_cols; j++) {
+            int gj = globalIndex(j, nb, pcol, q);
+            double entry = randomEntry(matrix_seed, n, gj, gi);
+            if (fabs(entry - randomEntry(matrix_seed, n, gi, gj)) > EPSILON) {
+                local_check = false;
+            }
+
+            if (local_T[i * local_cols + j] != entry) {
+                local_transposed = false;
+            }
+        }
+    }
+
+    MPI_Reduce(&local_check, &check, 1, MPI_C_BOOL, MPI_LAND, 0, grid_comm);
+    MPI_Reduce(&local_transposed, &transposed, 1, MPI_C_BOOL, MPI_LAND, 0, grid_comm);
+
+    if (prow == 0 && pcol == 0) {
+        printf("Tested results: symmetry %s and transposed %s.\n\n", check ? "true" : "false", transposed ? "correct" : "incorrect");
+    }
+}
+
+int main(int argc, char** argv) {
+#ifndef MPI_VERSION
+    printf("Error: compile with MPI support!\n");
+    return -1;
+#endif
+
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [bs=block size] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+    int nb = getOption(argc, argv, "bs") != NULL ? atoi(getOption(argc, argv, "bs")) : DEFAULT_BLOCK_SIZE;
+    if (nb <= 0) nb = DEFAULT_BLOCK_SIZE;
+
+    // Setup MPI
+    int size, rank;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // The largest square grid is used, the remaining processes stay idle
+    q = (int)sqrt(size);
+    while ((q + 1) * (q + 1) <= size) q++;
+    while (q * q > size) q--;
+
+    if (rank == 0) {
+        printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
+        printf("Matrix dimension: %d\n", n);
+        printf("Repetitions: %d\n", rep);
+        printf("Processes: %d\n", size);
+        printf("Process grid: %d x %d (%d idle)\n", q, q, size - q * q);
+        printf("Block size: %d\n\n", nb);
+    }
+
+    MPI_Comm active_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, rank < q * q ? 0 : MPI_UNDEFINED, rank, &active_comm);
+    if (active_comm == MPI_COMM_NULL) {
+        MPI_Finalize();
+        return 0;
+    }
+
+    int dims[2] = {q, q};
+    int periods[2] = {0, 0};
+    int coords[2];
+    MPI_Cart_create(active_comm, 2, dims, periods, 0, &grid_comm);
+    MPI_Cart_coords(grid_comm, rank, 2, coords);
+    prow = coords[0];
+    pcol = coords[1];
+    coords[0] = pcol;
+    coords[1] = prow;
+    MPI_Cart_rank(grid_comm, coords, &partner);
+
+    // Variables declaration
+    double t1 = 0, t2 = 0;      // effective times
+    double t1m, t1e, t2m, t2e;  // execution times
+    BenchmarkStats s1, s2;      // statistics of the repetitions
+    CounterValues c1, c2;       // hardware counters of the repetitions
+    bool symmetric = false;     // symmetry check
+    double *local_M, *local_T;  // block-cyclic local arrays of the input and transposed matrices
+    double* partner_M;          // local array of the partner process
+
+    local_rows = numroc(n, nb, prow, q);
+    local_cols = numroc(n, nb, pcol, q);
+
+    // Local arrays allocation and generation
+    local_M = (double*)allocBuffer(local_rows * local_cols * sizeof(double));
+    local_T = (double*)allocBuffer(local_rows * local_cols * sizeof(double));
+    partner_M = (double*)allocBuffer(local_rows * local_cols * sizeof(double));
+
+    if (local_rows * local_cols > 0 && (local_M == NULL || local_T == NULL || partner_M == NULL)) {
+        printf("Error in allocating matrices!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    initSeedDistributed(grid_comm);
+    for (int i = 0; i < local_rows; i++) {
+        for (int j = 0; j < local_cols; j++) {
+            local_M[i * local_cols + j] = randomEntry(matrix_seed, n, globalIndex(i, nb, prow, q), globalIndex(j, nb, pcol, q));
+        }
+    }
+
+    stripes = (local_rows + SYM_STRIPE - 1) / SYM_STRIPE;
+    MPI_Allreduce(MPI_IN_PLACE, &stripes, 1, MPI_INT, MPI_MAX, grid_comm);
+
+    tile_kernel = selectTileKernel();
+    sym_kernel = selectSymKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, grid_comm);
+
+    MPI_Barrier(grid_comm);
+
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(local_M, partner_M, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(local_M, partner_M, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, grid_comm);
+    c1 = countersCollectMPI(rep, grid_comm);
+
+    MPI_Barrier(grid_comm);
+
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(local_M, local_T, partner_M, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(local_M, local_T, partner_M, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, grid_comm);
+    c2 = countersCollectMPI(rep, grid_comm);
+
+    MPI_Barrier(grid_comm);
+
+    // Results printing and saving
+    MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, grid_comm);
+    MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, grid_comm);
+    if (rank == 0) {
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
+
+        printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
+        printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, q * q, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
+            printf("Error in saving results!\n\n");
+        }
+    }
+
+    testResultsGrid(local_T, n, nb);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(grid_comm);
+    traceFree();
+
+    // Matrices deallocation
+    freeBuffer(local_M);
+    freeBuffer(local_T);
+    freeBuffer(partner_M);
+
+    MPI_Comm_free(&grid_comm);
+    MPI_Comm_free(&active_comm);
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    MPI_Finalize();
+
+    return 0;
+}
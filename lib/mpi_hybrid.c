@@ -0,0 +1,298 @@
+#include <limits.h>
+#include <math.h>
+#include <mpi.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
+
+#define CODE "MH"
+
+#define ROW_GROUP 8  // rows handled by a thread at a time, one SIMD micro-tile high
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+SymKernel sym_kernel = checkTileSymScalar;     // selected at runtime by CPUID
+
+MPI_Datatype *send_types, *recv_types;                    // per rank, the blocks have uneven widths
+int *send_counts, *send_displs, *recv_counts, *recv_displs;  // displacements in bytes, the received ones in the types
+long exchange_bytes = 0;                                     // received by every exchange, for the trace
+
+int stripe = SYM_STRIPE;  // rows between two polls of the symmetry flag, equal on every rank
+
+// Same exchange of MA: the block of the columns owned by rank q is sent to rank q with a single all-to-all
+void exchangeBlocks(double* local_M, double* blocks) {
+    double start = MPI_Wtime();
+    MPI_Alltoallw(local_M, send_counts, send_displs, send_types, blocks, recv_counts, recv_displs, recv_types, MPI_COMM_WORLD);
+    traceSpan("MPI_Alltoallw", -1, start, MPI_Wtime(), exchange_bytes);
+}
+
+bool checkSymMPI(double* local_M, double* blocks, int n, int rank, int size, double* t) {
+    int chunk = partitionRows(n, size, rank);
+    int max_rows = partitionRows(n, size, 0);  // same number of stripes on every rank
+    SymmetryFlag flag;
+
+    exchangeBlocks(local_M, blocks);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    // The threads split the rows of every stripe, the master thread polls the distributed flag between stripes
+    symmetryFlagInit(&flag);
+    for (int i = 0; i < max_rows; i += stripe) {
+        if (!symmetryFlagPoll(&flag, MPI_COMM_WORLD)) break;
+        if (!flag.local) continue;
+
+        int end = i + stripe < chunk ? i + stripe : chunk;
+        int check = 1;
+
+#pragma omp parallel for schedule(static) reduction(&& : check)
+        for (int k = i; k < end; k += ROW_GROUP) {
+            int rows = ROW_GROUP < end - k ? ROW_GROUP : end - k;
+            for (int q = 0; q <= rank && check; q++) {
+                int q_start = partitionStart(n, size, q);
+                check = sym_kernel(local_M + k * n + q_start, blocks + q_start * chunk + k, rows, partitionRows(n, size, q), n, chunk, EPSILON);
+            }
+        }
+
+        flag.local = check;
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    return symmetryFlagResult(&flag, MPI_COMM_WORLD);
+}
+
+void matTransposeMPI(double* local_M, double* local_T, double* blocks, int n, int rank, int size, double* t) {
+    int chunk = partitionRows(n, size, rank);
+
+    exchangeBlocks(local_M, blocks);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    // Every thread writes whole rows of the transposed slab, the same rows it touched first
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < chunk; k += ROW_GROUP) {
+        int rows = ROW_GROUP < chunk - k ? ROW_GROUP : chunk - k;
+        for (int q = 0; q < size; q++) {
+            int q_start = partitionStart(n, size, q);
+            tile_kernel(blocks + q_start * chunk + k, local_T + k * n + q_start, partitionRows(n, size, q), rows, chunk, n);
+        }
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+}
+
+int main(int argc, char** argv) {
+#ifndef MPI_VERSION
+    printf("Error: compile with MPI support!\n");
+    return -1;
+#endif
+
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+
+    // Setup MPI, only the master thread of each process communicates
+    int size, rank, provided, threads;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    threads = omp_get_max_threads();
+    MPI_Allreduce(MPI_IN_PLACE, &threads, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    stripe = SYM_STRIPE * threads;
+
+    if (rank == 0) {
+        printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
+        printf("Matrix dimension: %d\n", n);
+        printf("Repetitions: %d\n", rep);
+        printf("Processes: %d\n", size);
+        printf("Threads: %d\n\n", threads);
+    }
+
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0) {
+            printf("Error: the MPI library does not support threads!\n");
+        }
+
+        MPI_Finalize();
+        return -1;
+    }
+
+    // Variables declaration
+    double t1 = 0, t2 = 0;      // effective times
+    double t1m, t1e, t2m, t2e;  // execution times
+    BenchmarkStats s1, s2;      // statistics of the repetitions
+    CounterValues c1, c2;       // hardware counters of the repetitions
+    bool symmetric = false;     // symmetry check
+    double *local_M, *local_T;  // row slabs of the input and transposed matrices
+    double* blocks;             // blocks received from the other processes
+    int row_start = partitionStart(n, size, rank);
+    int chunk = partitionRows(n, size, rank);
+
+    // The slabs and the blocks exchanged are counted and indexed in int elements, the largest slab is the one of rank 0
+    if ((long)partitionRows(n, size, 0) * n > INT_MAX) {
+        if (rank == 0) printf("Error: slabs of more than %d elements, use more processes!\n\n", INT_MAX);
+        MPI_Finalize();
+        return -1;
+    }
+
+    // Slabs allocation
+    local_M = (double*)allocBuffer((size_t)chunk * n * sizeof(double));
+    local_T = (double*)allocBuffer((size_t)chunk * n * sizeof(double));
+    blocks = (double*)allocBuffer((size_t)chunk * n * sizeof(double));
+
+    if (chunk > 0 && (local_M == NULL || local_T == NULL || blocks == NULL)) {
+        printf("Error in allocating matrices!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // Counters opened before the first parallel region, so that the OpenMP threads inherit them
+    countersInit(argc, argv, rank == 0);
+
+    // NUMA-aware first touch: the pages of each row group are touched by the thread that later works on them
+    initSeedDistributed(MPI_COMM_WORLD);
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < chunk; k += ROW_GROUP) {
+        int rows = ROW_GROUP < chunk - k ? ROW_GROUP : chunk - k;
+        fillSlab(local_M + k * n, n, row_start + k, rows);
+        memset(local_T + k * n, 0, rows * n * sizeof(double));
+        memset(blocks + k * n, 0, rows * n * sizeof(double));
+    }
+
+    // Derived data types definition: the block sent to rank q is chunk x rows of q, received contiguously
+    send_types = (MPI_Datatype*)malloc(size * sizeof(MPI_Datatype));
+    recv_types = (MPI_Datatype*)malloc(size * sizeof(MPI_Datatype));
+    send_counts = (int*)malloc(size * sizeof(int));
+    send_displs = (int*)malloc(size * sizeof(int));
+    recv_counts = (int*)malloc(size * sizeof(int));
+    recv_displs = (int*)malloc(size * sizeof(int));
+
+    for (int q = 0; q < size; q++) {
+        MPI_Type_vector(chunk, partitionRows(n, size, q), n, MPI_DOUBLE, &send_types[q]);
+        MPI_Type_commit(&send_types[q]);
+        send_counts[q] = 1;
+        send_displs[q] = partitionStart(n, size, q) * sizeof(double);
+
+        MPI_Aint recv_offset = (MPI_Aint)partitionStart(n, size, q) * chunk * sizeof(double);  // past INT_MAX for large slabs
+        MPI_Type_create_hindexed_block(1, partitionRows(n, size, q) * chunk, &recv_offset, MPI_DOUBLE, &recv_types[q]);
+        MPI_Type_commit(&recv_types[q]);
+        recv_counts[q] = 1;
+        exchange_bytes += (long)partitionRows(n, size, q) * chunk * sizeof(double);
+        recv_displs[q] = 0;
+    }
+
+    tile_kernel = selectTileKernel();
+    sym_kernel = selectSymKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    traceInit(argc, argv, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(local_M, blocks, n, rank, size, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(local_M, blocks, n, rank, size, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(local_M, local_T, blocks, n, rank, size, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(local_M, local_T, blocks, n, rank, size, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // Results printing and saving
+    MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
+
+        printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
+        printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, size, threads, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
+            printf("Error in saving results!\n\n");
+        }
+    }
+
+    testResultsDistributed(local_T, n, row_start, chunk, MPI_COMM_WORLD);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
+    // Matrices deallocation
+    freeBuffer(local_M);
+    freeBuffer(local_T);
+    freeBuffer(blocks);
+
+    // Derived data types deallocation
+    for (int q = 0; q < size; q++) {
+        MPI_Type_free(&send_types[q]);
+        MPI_Type_free(&recv_types[q]);
+    }
+    free(send_types);
+    free(recv_types);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,401 @@
+#include <math.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
+
+#define CODE "MP"
+
+#define DEFAULT_STAGES 4
+
+#if MPI_VERSION >= 4
+#define PERSISTENT_COLLECTIVES  // MPI-4 persistent collectives, created once and restarted at every call
+#endif
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+EqualKernel equal_kernel = checkEqualScalar;   // selected at runtime by CPUID
+
+MPI_Datatype type_row_n, type_column_n, type_column_chunk;
+
+int stages = DEFAULT_STAGES;
+int *stage_slab_counts, *stage_slab_displs;          // rows of every stage of the transpose, in elements of M
+int *stage_column_counts, *stage_column_displs;      // columns of T gathered at every stage of the transpose
+int *stage_triangle_counts, *stage_triangle_displs;  // rows (and columns) of every stage of the symmetry check
+MPI_Request *scatter_requests, *gather_requests, *row_requests, *column_requests;
+
+// First local row of the stage s of the symmetry check: the stages of a rank hold the same number of pairs, so that the
+// stripes of every stage are as long on every rank
+int triangleStageStart(int n, int size, int rank, int s) {
+    int row_start = triangleStart(n, size, rank);
+    return triangleSplit(row_start, triangleStart(n, size, rank + 1), s, stages) - row_start;
+}
+
+// The rows of every rank are split again in stages: the counts of rank r at stage s are at index s * size + r
+void stageCounts(int n, int size, bool triangle, int unit, int* counts, int* displs) {
+    for (int r = 0; r < size; r++) {
+        int start = triangle ? triangleStart(n, size, r) : partitionStart(n, size, r);
+        int rows = partitionRows(n, size, r);
+        for (int s = 0; s < stages; s++) {
+            int first = triangle ? triangleStageStart(n, size, r, s) : partitionStart(rows, stages, s);
+            int end = triangle ? triangleStageStart(n, size, r, s + 1) : partitionStart(rows, stages, s + 1);
+            counts[s * size + r] = (end - first) * unit;
+            displs[s * size + r] = (start + first) * unit;
+        }
+    }
+}
+
+// Stage s of the transpose: rows of the slab scattered from M, columns of T gathered from the transposed slab
+void startScatter(double* M, double* temp_rows, int n, int rank, int size, int s) {
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Start(&scatter_requests[s]);
+#else
+    int chunk = partitionRows(n, size, rank);
+    MPI_Iscatterv(M, stage_slab_counts + s * size, stage_slab_displs + s * size, MPI_DOUBLE,
+                  temp_rows + partitionStart(chunk, stages, s) * n, partitionRows(chunk, stages, s) * n, MPI_DOUBLE,
+                  0, MPI_COMM_WORLD, &scatter_requests[s]);
+#endif
+}
+
+void startGather(double* T, double* temp_columns, int n, int rank, int size, int s) {
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Start(&gather_requests[s]);
+#else
+    int chunk = partitionRows(n, size, rank);
+    MPI_Igatherv(temp_columns + partitionStart(chunk, stages, s), partitionRows(chunk, stages, s), type_column_chunk,
+                 T, stage_column_counts + s * size, stage_column_displs + s * size, type_column_n,
+                 0, MPI_COMM_WORLD, &gather_requests[s]);
+#endif
+}
+
+// Stage s of the symmetry check: rows and columns of the same global indices, both received as rows
+void startTriangleStage(double* M, double* temp_rows, double* temp_columns, int n, int rank, int size, int s) {
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Start(&row_requests[s]);
+    MPI_Start(&column_requests[s]);
+#else
+    int first = triangleStageStart(n, size, rank, s);
+    int rows = triangleStageStart(n, size, rank, s + 1) - first;
+    MPI_Iscatterv(M, stage_triangle_counts + s * size, stage_triangle_displs + s * size, type_row_n,
+                  temp_rows + first * n, rows, type_row_n, 0, MPI_COMM_WORLD, &row_requests[s]);
+    MPI_Iscatterv(M, stage_triangle_counts + s * size, stage_triangle_displs + s * size, type_column_n,
+                  temp_columns + first * n, rows, type_row_n, 0, MPI_COMM_WORLD, &column_requests[s]);
+#endif
+}
+
+#ifdef PERSISTENT_COLLECTIVES
+void initPersistentRequests(double* M, double* T, double* temp_rows, double* temp_columns, int n, int rank, int size) {
+    int chunk = partitionRows(n, size, rank);
+
+    for (int s = 0; s < stages; s++) {
+        int first = partitionStart(chunk, stages, s);
+        int rows = partitionRows(chunk, stages, s);
+        MPI_Scatterv_init(M, stage_slab_counts + s * size, stage_slab_displs + s * size, MPI_DOUBLE,
+                          temp_rows + first * n, rows * n, MPI_DOUBLE, 0, MPI_COMM_WORLD, MPI_INFO_NULL, &scatter_requests[s]);
+        MPI_Gatherv_init(temp_columns + first, rows, type_column_chunk,
+                         T, stage_column_counts + s * size, stage_column_displs + s * size, type_column_n,
+                         0, MPI_COMM_WORLD, MPI_INFO_NULL, &gather_requests[s]);
+
+        first = triangleStageStart(n, size, rank, s);
+        rows = triangleStageStart(n, size, rank, s + 1) - first;
+        MPI_Scatterv_init(M, stage_triangle_counts + s * size, stage_triangle_displs + s * size, type_row_n,
+                          temp_rows + first * n, rows, type_row_n, 0, MPI_COMM_WORLD, MPI_INFO_NULL, &row_requests[s]);
+        MPI_Scatterv_init(M, stage_triangle_counts + s * size, stage_triangle_displs + s * size, type_column_n,
+                          temp_columns + first * n, rows, type_row_n, 0, MPI_COMM_WORLD, MPI_INFO_NULL, &column_requests[s]);
+    }
+}
+
+void freePersistentRequests() {
+    for (int s = 0; s < stages; s++) {
+        MPI_Request_free(&scatter_requests[s]);
+        MPI_Request_free(&gather_requests[s]);
+        MPI_Request_free(&row_requests[s]);
+        MPI_Request_free(&column_requests[s]);
+    }
+}
+#endif
+
+bool checkSymMPI(double* M, double* temp_rows, double* temp_columns, int n, int rank, int size, double* t) {
+    int row_start = triangleStart(n, size, rank);
+    int stripes = (triangleStripes(n, size) + stages - 1) / stages;  // per stage, the same on every rank
+    SymmetryFlag flag;
+    bool stop = false;  // early exit, reached at the same stage by every rank
+
+    // All the stages are posted at once, the rows of a stage are compared while the next ones are still in flight
+    for (int s = 0; s < stages; s++) startTriangleStage(M, temp_rows, temp_columns, n, rank, size, s);
+
+    symmetryFlagInit(&flag);
+    for (int s = 0; s < stages && !stop; s++) {
+        int first = triangleStageStart(n, size, rank, s);
+        int end = triangleStageStart(n, size, rank, s + 1);
+
+        double start = MPI_Wtime();
+        MPI_Wait(&row_requests[s], MPI_STATUS_IGNORE);
+        MPI_Wait(&column_requests[s], MPI_STATUS_IGNORE);
+        traceSpan("MPI_Wait", s, start, MPI_Wtime(), 2L * (end - first) * n * sizeof(double));
+
+        double t1 = MPI_Wtime();
+        countersStart();
+
+        for (int i = 0; i < stripes; i++) {
+            if (!symmetryFlagPoll(&flag, MPI_COMM_WORLD)) {
+                stop = true;
+                break;
+            }
+
+            // row and column of the same global index are compared up to the diagonal
+            int stripe_end = triangleSplit(row_start + first, row_start + end, i + 1, stripes) - row_start;
+            for (int k = triangleSplit(row_start + first, row_start + end, i, stripes) - row_start; k < stripe_end && flag.local; k++) {
+                flag.local = equal_kernel(temp_rows + (size_t)k * n, temp_columns + (size_t)k * n, row_start + k, EPSILON);
+            }
+        }
+
+        countersStop();
+        double t2 = MPI_Wtime();
+        *t += t2 - t1;
+        traceSpan(__func__, s, t1, t2, 0);
+    }
+
+    // The stages skipped by the early exit are still delivered
+    MPI_Waitall(stages, row_requests, MPI_STATUSES_IGNORE);
+    MPI_Waitall(stages, column_requests, MPI_STATUSES_IGNORE);
+
+    return symmetryFlagResult(&flag, MPI_COMM_WORLD);
+}
+
+void matTransposeMPI(double* M, double* T, double* temp_rows, double* temp_columns, int n, int rank, int size, double* t) {
+    int chunk = partitionRows(n, size, rank);
+
+    for (int s = 0; s < stages; s++) startScatter(M, temp_rows, n, rank, size, s);
+
+    // The gather of a stage overlaps the transpose of the next one
+    for (int s = 0; s < stages; s++) {
+        int first = partitionStart(chunk, stages, s);
+
+        double start = MPI_Wtime();
+        MPI_Wait(&scatter_requests[s], MPI_STATUS_IGNORE);
+        traceSpan("MPI_Wait", s, start, MPI_Wtime(), (long)partitionRows(chunk, stages, s) * n * sizeof(double));
+
+        double t1 = MPI_Wtime();
+        countersStart();
+
+        tile_kernel(temp_rows + first * n, temp_columns + first, partitionRows(chunk, stages, s), n, n, chunk);
+
+        countersStop();
+        double t2 = MPI_Wtime();
+        *t += t2 - t1;
+        traceSpan(__func__, s, t1, t2, 0);
+
+        startGather(T, temp_columns, n, rank, size, s);
+    }
+
+    double start = MPI_Wtime();
+    MPI_Waitall(stages, gather_requests, MPI_STATUSES_IGNORE);
+    traceSpan("MPI_Waitall", -1, start, MPI_Wtime(), (long)chunk * n * sizeof(double));
+}
+
+int main(int argc, char** argv) {
+#ifndef MPI_VERSION
+    printf("Error: compile with MPI support!\n");
+    return -1;
+#endif
+
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [stages=number of stages] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+    stages = getOption(argc, argv, "stages") != NULL ? atoi(getOption(argc, argv, "stages")) : DEFAULT_STAGES;
+    if (stages <= 0) stages = DEFAULT_STAGES;
+
+    // Setup MPI
+    int size, rank;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (rank == 0) {
+        printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
+        printf("Matrix dimension: %d\n", n);
+        printf("Repetitions: %d\n", rep);
+        printf("Processes: %d\n", size);
+#ifdef PERSISTENT_COLLECTIVES
+        printf("Stages: %d (persistent collectives)\n\n", stages);
+#else
+        printf("Stages: %d (non-blocking collectives)\n\n", stages);
+#endif
+    }
+
+    // Variables declaration
+    double t1 = 0, t2 = 0;             // effective times
+    double t1m, t1e, t2m, t2e;         // execution times
+    BenchmarkStats s1, s2;             // statistics of the repetitions
+    CounterValues c1, c2;              // hardware counters of the repetitions
+    bool symmetric = false;            // symmetry check
+    double* M = NULL;                  // input matrix
+    double* T = NULL;                  // transposed matrix
+    double *temp_rows, *temp_columns;  // temporary matrix
+
+    // Matrices allocation
+    if (rank == 0) {
+        if (allocMatrices(&M, &T, n) == -1) {
+            printf("Error in allocating matrices!\n\n");
+            MPI_Abort(MPI_COMM_WORLD, -1);
+        }
+    }
+    fillMatrixDistributed(M, n, MPI_COMM_WORLD);
+
+    int chunk = partitionRows(n, size, rank);
+    int max_chunk = chunk > triangleRows(n, size, rank) ? chunk : triangleRows(n, size, rank);
+    temp_rows = (double*)allocBuffer(max_chunk * n * sizeof(double));
+    temp_columns = (double*)allocBuffer(max_chunk * n * sizeof(double));
+
+    // Stages partitioning
+    stage_slab_counts = (int*)malloc(stages * size * sizeof(int));
+    stage_slab_displs = (int*)malloc(stages * size * sizeof(int));
+    stage_column_counts = (int*)malloc(stages * size * sizeof(int));
+    stage_column_displs = (int*)malloc(stages * size * sizeof(int));
+    stage_triangle_counts = (int*)malloc(stages * size * sizeof(int));
+    stage_triangle_displs = (int*)malloc(stages * size * sizeof(int));
+    stageCounts(n, size, false, n, stage_slab_counts, stage_slab_displs);
+    stageCounts(n, size, false, 1, stage_column_counts, stage_column_displs);
+    stageCounts(n, size, true, 1, stage_triangle_counts, stage_triangle_displs);
+
+    scatter_requests = (MPI_Request*)malloc(stages * sizeof(MPI_Request));
+    gather_requests = (MPI_Request*)malloc(stages * sizeof(MPI_Request));
+    row_requests = (MPI_Request*)malloc(stages * sizeof(MPI_Request));
+    column_requests = (MPI_Request*)malloc(stages * sizeof(MPI_Request));
+
+    // Derived data types definition
+    MPI_Datatype type_column;
+
+    MPI_Type_contiguous(n, MPI_DOUBLE, &type_row_n);
+    MPI_Type_commit(&type_row_n);
+
+    MPI_Type_vector(n, 1, n, MPI_DOUBLE, &type_column);
+    MPI_Type_create_resized(type_column, 0, 1 * sizeof(double), &type_column_n);
+    MPI_Type_commit(&type_column_n);
+    MPI_Type_free(&type_column);
+
+    MPI_Type_vector(n, 1, chunk > 0 ? chunk : 1, MPI_DOUBLE, &type_column);
+    MPI_Type_create_resized(type_column, 0, 1 * sizeof(double), &type_column_chunk);
+    MPI_Type_commit(&type_column_chunk);
+    MPI_Type_free(&type_column);
+
+#ifdef PERSISTENT_COLLECTIVES
+    initPersistentRequests(M, T, temp_rows, temp_columns, n, rank, size);
+#endif
+
+    tile_kernel = selectTileKernel();
+    equal_kernel = selectEqualKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(M, temp_rows, temp_columns, n, rank, size, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(M, temp_rows, temp_columns, n, rank, size, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(M, T, temp_rows, temp_columns, n, rank, size, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(M, T, temp_rows, temp_columns, n, rank, size, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // Results printing and saving
+    MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
+
+        printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
+        printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, size, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
+            printf("Error in saving results!\n\n");
+        }
+    }
+
+    // Transpose checked slab-wise on every rank
+    testResultsScattered(T, n, MPI_COMM_WORLD);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
+    // Matrices deallocation
+#ifdef PERSISTENT_COLLECTIVES
+    freePersistentRequests();
+#endif
+
+    freeBuffer(M);
+    freeBuffer(T);
+    freeBuffer(temp_rows);
+    freeBuffer(temp_columns);
+    free(stage_slab_counts);
+    free(stage_slab_displs);
+    free(stage_column_counts);
+    free(stage_column_displs);
+    free(stage_triangle_counts);
+    free(stage_triangle_displs);
+    free(scatter_requests);
+    free(gather_requests);
+    free(row_requests);
+    free(column_requests);
+
+    // Derived data types deallocation
+    MPI_Type_free(&type_row_n);
+    MPI_Type_free(&type_column_n);
+    MPI_Type_free(&type_column_chunk);
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include <math.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "functions.h"
+#include "matrix_io.h"
+#include "mpi_functions.h"
+#include "simd.h"
+
+#define CODE "MR"
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+SymKernel sym_kernel = checkTileSymScalar;     // selected at runtime by CPUID
+
+MPI_Win win_M, win_T;        // row slabs of M and T exposed to the other ranks, locked once for the whole run
+MPI_Datatype* block_types;   // block of the columns of this rank in the slab of rank q, rows of q x rows of this rank
+
+// The blocks of the columns of this rank are read from the slabs of M of the ranks up to this one, the others are
+// compared by the ranks that own their mirror
+void getBlocks(double* blocks, int n, int rank, int size) {
+    int chunk = partitionRows(n, size, rank);
+
+    double start = MPI_Wtime();
+    for (int q = 0; q <= rank; q++) {
+        int rows = partitionRows(n, size, q);
+        MPI_Get(blocks + partitionStart(n, size, q) * chunk, rows * chunk, MPI_DOUBLE, q,
+                partitionStart(n, size, rank), 1, block_types[q], win_M);
+    }
+    MPI_Win_flush_all(win_M);
+    traceSpan("MPI_Get", -1, start, MPI_Wtime(), (long)partitionStart(n, size, rank + 1) * chunk * sizeof(double));
+}
+
+bool checkSymMPI(double* local_M, double* blocks, int n, int rank, int size, double* t) {
+    int chunk = partitionRows(n, size, rank);
+    int max_rows = partitionRows(n, size, 0);  // same number of stripes on every rank
+    SymmetryFlag flag;
+
+    getBlocks(blocks, n, rank, size);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    // Block q of the slab must match the transposed block read from rank q, up to the diagonal block
+    symmetryFlagInit(&flag);
+    for (int i = 0; i < max_rows; i += SYM_STRIPE) {
+        if (!symmetryFlagPoll(&flag, MPI_COMM_WORLD)) break;
+
+        int rows = SYM_STRIPE < chunk - i ? SYM_STRIPE : chunk - i;
+        for (int q = 0; q <= rank && flag.local && rows > 0; q++) {
+            int q_start = partitionStart(n, size, q);
+            flag.local = sym_kernel(local_M + i * n + q_start, blocks + q_start * chunk + i, rows, partitionRows(n, size, q), n, chunk, EPSILON);
+        }
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    return symmetryFlagResult(&flag, MPI_COMM_WORLD);
+}
+
+void matTransposeMPI(double* local_M, double* blocks, int n, int rank, int size, double* t) {
+    int chunk = partitionRows(n, size, rank);
+
+    // Every block is transposed locally and written with a put in its final position in the slab of T of rank q,
+    // the transfer of a block overlaps the transpose of the next one
+    for (int q = 0; q < size; q++) {
+        int q_start = partitionStart(n, size, q);
+        int rows = partitionRows(n, size, q);
+
+        double t1 = MPI_Wtime();
+        countersStart();
+
+        tile_kernel(local_M + q_start, blocks + q_start * chunk, chunk, rows, n, chunk);
+
+        countersStop();
+        double t2 = MPI_Wtime();
+        *t += t2 - t1;
+        traceSpan(__func__, q, t1, t2, 0);
+
+        MPI_Put(blocks + q_start * chunk, rows * chunk, MPI_DOUBLE, q, partitionStart(n, size, rank), 1, block_types[q], win_T);
+    }
+
+    // A single synchronization per call: the puts are complete at their targets before any rank reads its slab
+    double start = MPI_Wtime();
+    MPI_Win_flush_all(win_T);
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Win_sync(win_T);
+    traceSpan("MPI_Win_flush_all", -1, start, MPI_Wtime(), (long)n * chunk * sizeof(double));
+}
+
+int main(int argc, char** argv) {
+#ifndef MPI_VERSION
+    printf("Error: compile with MPI support!\n");
+    return -1;
+#endif
+
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [input=file] [output=file] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+
+    // Setup MPI
+    int size, rank;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // The dimension of the input file replaces [n]
+    const char* input_name = getOption(argc, argv, "input");
+    const char* output_name = getOption(argc, argv, "output");
+    if (input_name != NULL && (int)(n = readMatrixDimensionMPI(input_name, MPI_COMM_WORLD)) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Finalize();
+        return -1;
+    }
+
+    if (rank == 0) {
+        printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
+        printf("Matrix dimension: %d\n", n);
+        printf("Repetitions: %d\n", rep);
+        printf("Processes: %d\n\n", size);
+    }
+
+    // Variables declaration
+    double t1 = 0, t2 = 0;      // effective times
+    double t1m, t1e, t2m, t2e;  // execution times
+    BenchmarkStats s1, s2;      // statistics of the repetitions
+    CounterValues c1, c2;       // hardware counters of the repetitions
+    bool symmetric = false;     // symmetry check
+    double *local_M, *local_T;  // row slabs of the input and transposed matrices, exposed in windows
+    double* blocks;             // blocks read from (or transposed for) the other processes
+    int row_start = partitionStart(n, size, rank);
+    int chunk = partitionRows(n, size, rank);
+
+    // Slabs allocation: the windows own the slabs, each process generates (or reads from the input file) only its rows
+    MPI_Win_allocate(chunk * n * sizeof(double), sizeof(double), MPI_INFO_NULL, MPI_COMM_WORLD, &local_M, &win_M);
+    MPI_Win_allocate(chunk * n * sizeof(double), sizeof(double), MPI_INFO_NULL, MPI_COMM_WORLD, &local_T, &win_T);
+    blocks = (double*)allocBuffer((size_t)chunk * n * sizeof(double));
+
+    if (chunk > 0 && blocks == NULL) {
+        printf("Error in allocating matrices!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    if (input_name == NULL) {
+        initSeedDistributed(MPI_COMM_WORLD);
+        fillSlab(local_M, n, row_start, chunk);
+    } else if (readSlabMPI(input_name, local_M, n, row_start, chunk, MPI_COMM_WORLD) == -1) {
+        if (rank == 0) printf("Error in reading the input file!\n\n");
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // Derived data types definition: the target block in the slab of rank q is rows of q x chunk, with stride n
+    block_types = (MPI_Datatype*)malloc(size * sizeof(MPI_Datatype));
+    for (int q = 0; q < size; q++) {
+        MPI_Type_vector(partitionRows(n, size, q), chunk, n, MPI_DOUBLE, &block_types[q]);
+        MPI_Type_commit(&block_types[q]);
+    }
+
+    // Passive target epochs for the whole run, completed by flushes
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win_M);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win_T);
+    MPI_Win_sync(win_M);  // the generated slab is visible to the gets of the other processes
+
+    tile_kernel = selectTileKernel();
+    sym_kernel = selectSymKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(local_M, blocks, n, rank, size, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(local_M, blocks, n, rank, size, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(local_M, blocks, n, rank, size, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(local_M, blocks, n, rank, size, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // Results printing and saving
+    MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
+
+        printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
+        printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, size, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
+            printf("Error in saving results!\n\n");
+        }
+    }
+
+    // The regenerated input can only check a generated matrix
+    if (input_name == NULL) testResultsDistributed(local_T, n, row_start, chunk, MPI_COMM_WORLD);
+
+    if (output_name != NULL && writeSlabMPI(output_name, local_T, n, row_start, chunk, true, MPI_COMM_WORLD) == -1 && rank == 0) {
+        printf("Error in writing the output file!\n\n");
+    }
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
+    // Windows and matrices deallocation
+    MPI_Win_unlock_all(win_M);
+    MPI_Win_unlock_all(win_T);
+    MPI_Win_free(&win_M);
+    MPI_Win_free(&win_T);
+    freeBuffer(blocks);
+
+    // Derived data types deallocation
+    for (int q = 0; q < size; q++) MPI_Type_free(&block_types[q]);
+    free(block_types);
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    MPI_Finalize();
+
+    return 0;
+}
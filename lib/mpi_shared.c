@@ -0,0 +1,270 @@
+#include <math.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "functions.h"
+#include "mpi_functions.h"
+#include "simd.h"
+
+#define CODE "MS"
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+SymKernel sym_kernel = checkTileSymScalar;     // selected at runtime by CPUID
+
+MPI_Comm node_comm;              // processes sharing the memory of a node
+MPI_Comm leaders_comm;           // first process of every node, MPI_COMM_NULL on the others
+MPI_Win win_M, win_T;            // shared segments of the node, allocated by the node leader
+int nodes, node;                 // number of nodes and index of the node of this process
+int row_start, rows;             // rows of T (columns of M) computed by this process
+int stripes;                     // stripes of the symmetry check, the maximum over all the processes
+int *node_counts, *node_displs;  // elements of T computed by every node, for the leaders gather
+
+// Stores to the shared segment become visible to the other processes of the node
+void nodeSync(MPI_Win win) {
+    MPI_Win_sync(win);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(win);
+}
+
+// The leaders replicate M among the nodes, the processes of a node read it directly from the shared segment
+void distributeShared(double* M, int n) {
+    double start = MPI_Wtime();
+    if (leaders_comm != MPI_COMM_NULL && nodes > 1) {
+        MPI_Bcast(M, n * n, MPI_DOUBLE, 0, leaders_comm);
+    }
+    nodeSync(win_M);
+    traceSpan("MPI_Bcast", -1, start, MPI_Wtime(), leaders_comm != MPI_COMM_NULL && nodes > 1 ? (long)n * n * sizeof(double) : 0);
+}
+
+bool checkSymMPI(double* M, int n, double* t) {
+    SymmetryFlag flag;
+
+    distributeShared(M, n);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    symmetryFlagInit(&flag);
+    for (int s = 0; s < stripes; s++) {
+        if (!symmetryFlagPoll(&flag, MPI_COMM_WORLD)) break;
+
+        int i = row_start + s * SYM_STRIPE;
+        int count = SYM_STRIPE < row_start + rows - i ? SYM_STRIPE : row_start + rows - i;
+        if (flag.local && count > 0) flag.local = sym_kernel(M + i * n, M + i, count, i + count, n, n, EPSILON);
+    }
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    return symmetryFlagResult(&flag, MPI_COMM_WORLD);
+}
+
+void matTransposeMPI(double* M, double* T, int n, double* t) {
+    distributeShared(M, n);
+
+    double t1 = MPI_Wtime();
+    countersStart();
+
+    // Rows [row_start, row_start + rows) of T are the same columns of M, written in place in the shared segment
+    tile_kernel(M + row_start, T + row_start * n, n, rows, n, n);
+
+    countersStop();
+    double t2 = MPI_Wtime();
+    *t += t2 - t1;
+    traceSpan(__func__, -1, t1, t2, 0);
+
+    double start = MPI_Wtime();
+    nodeSync(win_T);
+
+    // Only the leaders exchange messages, collecting the rows computed by every node on the root
+    if (leaders_comm != MPI_COMM_NULL && nodes > 1) {
+        if (node == 0) {
+            MPI_Gatherv(MPI_IN_PLACE, 0, MPI_DOUBLE, T, node_counts, node_displs, MPI_DOUBLE, 0, leaders_comm);
+        } else {
+            MPI_Gatherv(T + node_displs[node], node_counts[node], MPI_DOUBLE, NULL, NULL, NULL, MPI_DOUBLE, 0, leaders_comm);
+        }
+        traceSpan("MPI_Gatherv", -1, start, MPI_Wtime(), node > 0 ? node_counts[node] * sizeof(double) : 0);
+    } else {
+        traceSpan("nodeSync", -1, start, MPI_Wtime(), 0);
+    }
+}
+
+int main(int argc, char** argv) {
+#ifndef MPI_VERSION
+    printf("Error: compile with MPI support!\n");
+    return -1;
+#endif
+
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [warmup=runs] [flush] [counters] [trace=file] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+
+    // Setup MPI
+    int size, rank, node_size, node_rank;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_size(node_comm, &node_size);
+    MPI_Comm_rank(node_comm, &node_rank);
+
+    MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &leaders_comm);
+    if (leaders_comm != MPI_COMM_NULL) {
+        MPI_Comm_size(leaders_comm, &nodes);
+        MPI_Comm_rank(leaders_comm, &node);
+    }
+    MPI_Bcast(&nodes, 1, MPI_INT, 0, node_comm);
+    MPI_Bcast(&node, 1, MPI_INT, 0, node_comm);
+
+    if (rank == 0) {
+        printf("Compiled with MPI %d.%d\n", MPI_VERSION, MPI_SUBVERSION);
+        printf("Matrix dimension: %d\n", n);
+        printf("Repetitions: %d\n", rep);
+        printf("Processes: %d\n", size);
+        printf("Nodes: %d\n\n", nodes);
+    }
+
+    // Variables declaration
+    double t1 = 0, t2 = 0;      // effective times
+    double t1m, t1e, t2m, t2e;  // execution times
+    BenchmarkStats s1, s2;      // statistics of the repetitions
+    CounterValues c1, c2;       // hardware counters of the repetitions
+    bool symmetric = false;     // symmetry check
+    double* M;                  // input matrix, one shared copy per node
+    double* T;                  // transposed matrix, one shared copy per node
+    MPI_Aint segment_size;
+    int displacement_unit;
+
+    // Shared matrices allocation: the leader owns the whole segment, the other processes map it
+    MPI_Win_allocate_shared(node_rank == 0 ? n * n * sizeof(double) : 0, sizeof(double), MPI_INFO_NULL, node_comm, &M, &win_M);
+    MPI_Win_allocate_shared(node_rank == 0 ? n * n * sizeof(double) : 0, sizeof(double), MPI_INFO_NULL, node_comm, &T, &win_T);
+    MPI_Win_shared_query(win_M, 0, &segment_size, &displacement_unit, &M);
+    MPI_Win_shared_query(win_T, 0, &segment_size, &displacement_unit, &T);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win_M);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win_T);
+
+    // Every node generates its copy of M, each process a slab of the rows from the seed shared by all of them
+    initSeedDistributed(MPI_COMM_WORLD);
+    int fill_start = partitionStart(n, node_size, node_rank);
+    fillSlab(M + (size_t)fill_start * n, n, fill_start, partitionRows(n, node_size, node_rank));
+    nodeSync(win_M);
+
+    // Columns split among the nodes, then among the processes of each node
+    int node_start = node * n / nodes;
+    int node_rows = (node + 1) * n / nodes - node_start;
+    row_start = node_start + node_rank * node_rows / node_size;
+    rows = node_start + (node_rank + 1) * node_rows / node_size - row_start;
+
+    stripes = (rows + SYM_STRIPE - 1) / SYM_STRIPE;
+    MPI_Allreduce(MPI_IN_PLACE, &stripes, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    node_counts = (int*)malloc(nodes * sizeof(int));
+    node_displs = (int*)malloc(nodes * sizeof(int));
+    for (int k = 0; k < nodes; k++) {
+        node_displs[k] = k * n / nodes * n;
+        node_counts[k] = ((k + 1) * n / nodes - k * n / nodes) * n;
+    }
+
+    tile_kernel = selectTileKernel();
+    sym_kernel = selectSymKernel();
+
+    // Parallel execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, rank == 0);
+    traceInit(argc, argv, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) symmetric = checkSymMPI(M, n, &t1);
+    t1 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        symmetric = checkSymMPI(M, n, &t1);
+        doNotOptimize(symmetric);
+        benchmarkStop(&bench, j);
+    }
+    s1 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c1 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int j = 0; j < bench.warmup; j++) matTransposeMPI(M, T, n, &t2);
+    t2 = 0;
+    countersReset();
+    for (int j = 0; j < rep; j++) {
+        benchmarkStart(&bench);
+        matTransposeMPI(M, T, n, &t2);
+        benchmarkStop(&bench, j);
+    }
+    s2 = benchmarkStatsMPI(&bench, MPI_COMM_WORLD);
+    c2 = countersCollectMPI(rep, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // Results printing and saving
+    MPI_Reduce(&t1, &t1e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&t2, &t2e, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        t1m = s1.mean;
+        t2m = s2.mean;
+        t1e = t1e / rep;
+        t2e = t2e / rep;
+
+        printf("Parallel execution (message passing included and excluded): symmetry: %s\n", symmetric ? "true" : "false");
+        printf("checkSymMPI:\t %.9f\t%.9f seconds\n", t1m, t1e);
+        printBenchmarkStats(&s1);
+        if (counters.enabled) printCounterValues(&c1);
+        printf("matTransposeMPI: %.9f\t%.9f seconds\n", t2m, t2e);
+        printBenchmarkStats(&s2);
+        if (counters.enabled) printCounterValues(&c2);
+        printf("\n");
+
+        if (saveResultsMPI(CODE, n, size, 1, &s1, t1e, &s2, t2e, &c1, &c2) == -1) {
+            printf("Error in saving results!\n\n");
+        }
+    }
+
+    // Transpose checked slab-wise on every rank
+    testResultsScattered(T, n, MPI_COMM_WORLD);
+
+    // Timeline of the collectives and compute phases of every rank
+    traceDump(MPI_COMM_WORLD);
+    traceFree();
+
+    // Shared matrices deallocation
+    MPI_Win_unlock_all(win_M);
+    MPI_Win_unlock_all(win_T);
+    MPI_Win_free(&win_M);
+    MPI_Win_free(&win_T);
+    free(node_counts);
+    free(node_displs);
+
+    if (leaders_comm != MPI_COMM_NULL) MPI_Comm_free(&leaders_comm);
+    MPI_Comm_free(&node_comm);
+
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,577 @@
+#ifdef PARCO_MPI
+#include <mpi.h>
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "element.h"
+#include "functions.h"
+#include "parco.h"
+#include "simd.h"
+#include "wisdom.h"
+
+#ifdef PARCO_MPI
+#include "mpi_functions.h"
+#endif
+
+#define BLOCK_SIZE 32  // default block size, without wisdom
+#define TUNE_REPETITIONS 4
+
+// Local transpose algorithms tried by the tuner, in the same order of the names stored in the wisdom file
+enum { ALGORITHM_NAIVE, ALGORITHM_BLOCKED, ALGORITHM_SIMD, ALGORITHMS };
+static const char* algorithm_names[ALGORITHMS] = {"naive", "blocked", "simd"};
+
+static int plans_alive = 0;  // the pooled buffers are unmapped with the last plan
+
+struct pt_plan {
+    int n;
+    pt_backend backend;
+    pt_dtype dtype;
+    ElementOps ops;  // kernels of the element type, all the offsets are in elements of ops.size bytes
+    double eps;
+    char code[16];  // wisdom code of the backend and of the element size
+    int algorithm;
+    int block_size;  // 0 for the naive algorithm
+    TileKernelAny tile_kernel;
+    EqualKernel equal_kernel;  // row against column of doubles, for the MPI symmetry check
+    char* buffer;              // one tile, for the in-place transpose of the blocked algorithms
+    size_t buffer_size;
+#ifdef PARCO_MPI
+    MPI_Comm comm;
+    int rank, size;
+    MPI_Datatype type_element;  // predefined, or contiguous bytes for PT_BYTES
+    MPI_Datatype type_row_n, type_column_n, type_column_chunk;
+    int *row_counts, *row_displs;            // balanced partition of the rows, for the transpose
+    int *triangle_counts, *triangle_displs;  // equal-area partition of the rows, for the symmetry check
+    char *temp_rows, *temp_columns;          // slab of rows and of columns of this rank
+    MPI_Datatype type_matrix;                // whole matrix, the unit of the batches
+    int *batch_counts, *batch_displs;        // balanced partition of the last batch
+    char *batch_in, *batch_out;              // matrices of this rank, grown to the largest batch
+    bool* batch_flags;
+    int batch_capacity;
+#endif
+};
+
+static pt_plan* planAllocate(int n, pt_backend backend, pt_dtype dtype, size_t element_size) {
+    if (n <= 0 || dtype < PT_DOUBLE || dtype > PT_BYTES || (dtype == PT_BYTES && element_size == 0)) return NULL;
+
+    pt_plan* plan = (pt_plan*)calloc(1, sizeof(pt_plan));
+    if (plan == NULL) return NULL;
+    plans_alive++;
+
+    plan->n = n;
+    plan->backend = backend;
+    plan->dtype = dtype;
+    plan->ops = elementOps((ElementType)dtype, element_size);
+    plan->eps = plan->ops.eps;
+    plan->equal_kernel = selectEqualKernel();
+    snprintf(plan->code, sizeof(plan->code), "%s%zu", backend == PT_MPI ? "PTM" : "PTS", plan->ops.size);
+
+    return plan;
+}
+
+// The tile buffer is only reallocated to grow, so the tuner allocates it once for its largest candidate
+static bool planReserveBuffer(pt_plan* plan, int block_size) {
+    size_t bytes = (size_t)block_size * block_size * plan->ops.size;
+    if (bytes <= plan->buffer_size) return true;
+
+    free(plan->buffer);
+    plan->buffer = (char*)malloc(bytes);
+    plan->buffer_size = plan->buffer != NULL ? bytes : 0;
+
+    return plan->buffer != NULL;
+}
+
+// The naive algorithm is a single scalar tile as large as the matrix, with no block size and no tile buffer
+static bool planSetAlgorithm(pt_plan* plan, int algorithm, int block_size) {
+    plan->algorithm = algorithm;
+    plan->block_size = algorithm == ALGORITHM_NAIVE ? 0 : block_size < plan->n ? block_size : plan->n;
+    plan->tile_kernel = algorithm == ALGORITHM_SIMD ? plan->ops.tile : plan->ops.tile_scalar;
+
+    return algorithm == ALGORITHM_NAIVE || planReserveBuffer(plan, plan->block_size);
+}
+
+// Side of the tiles passed to the kernels
+static int planTileSize(pt_plan* plan) {
+    return plan->algorithm == ALGORITHM_NAIVE ? plan->n : plan->block_size;
+}
+
+static const char* planCode(pt_plan* plan) {
+    return plan->code;
+}
+
+static int planProcesses(pt_plan* plan) {
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) return plan->size;
+#else
+    (void)plan;
+#endif
+    return 1;
+}
+
+// Algorithm and block size of the wisdom of this CPU, otherwise the SIMD kernels on blocks of BLOCK_SIZE
+static bool planApplyWisdom(pt_plan* plan) {
+    int choice[2] = {ALGORITHM_SIMD, BLOCK_SIZE};
+    Wisdom wisdom;
+    bool root = true;
+
+#ifdef PARCO_MPI
+    root = plan->backend != PT_MPI || plan->rank == 0;
+#endif
+    if (root && wisdomLookup(planCode(plan), plan->n, planProcesses(plan), &wisdom) && wisdom.block_size > 0) {
+        for (int a = 0; a < ALGORITHMS; a++) {
+            if (strcmp(wisdom.algorithm, algorithm_names[a]) == 0) {
+                choice[0] = a;
+                choice[1] = wisdom.block_size;
+            }
+        }
+    }
+#ifdef PARCO_MPI
+    // the wisdom read by rank 0 is the same on every process
+    if (plan->backend == PT_MPI) MPI_Bcast(choice, 2, MPI_INT, 0, plan->comm);
+#endif
+
+    return planSetAlgorithm(plan, choice[0], choice[1]);
+}
+
+// Sequential backend: the same blocked kernels of sequential.c and sequential_block.c
+
+static void transposeSequential(pt_plan* plan, const char* M, char* T) {
+    const int n = plan->n;
+    const int size = planTileSize(plan);
+    const size_t es = plan->ops.size;
+
+    for (int rb = 0; rb * size < n; rb++) {  // row blocks indexing
+        const int rows = size < n - rb * size ? size : n - rb * size;
+        for (int cb = 0; cb * size < n; cb++) {  // column blocks indexing
+            const int cols = size < n - cb * size ? size : n - cb * size;
+            plan->tile_kernel(M + ((size_t)rb * n + cb) * size * es, T + ((size_t)cb * n + rb) * size * es, rows, cols, n, n, es);
+        }
+    }
+}
+
+// Swaps every pair of mirrored elements, byte by byte as the elements may be records of any size
+static void transposeNaiveInPlace(pt_plan* plan, char* M) {
+    const int n = plan->n;
+    const size_t es = plan->ops.size;
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < i; j++) {
+            char* lower = M + ((size_t)i * n + j) * es;
+            char* upper = M + ((size_t)j * n + i) * es;
+            for (size_t b = 0; b < es; b++) {
+                char byte = lower[b];
+                lower[b] = upper[b];
+                upper[b] = byte;
+            }
+        }
+    }
+}
+
+static void transposeSequentialInPlace(pt_plan* plan, char* M) {
+    const int n = plan->n;
+    const int size = plan->block_size;
+    const size_t es = plan->ops.size;
+
+    if (plan->algorithm == ALGORITHM_NAIVE) {
+        transposeNaiveInPlace(plan, M);
+        return;
+    }
+
+    for (int rb = 0; rb * size < n; rb++) {  // row blocks indexing
+        const int rows = size < n - rb * size ? size : n - rb * size;
+        for (int cb = 0; cb <= rb; cb++) {  // column blocks of the lower triangular part
+            const int cols = size < n - cb * size ? size : n - cb * size;
+            char* lower = M + ((size_t)rb * n + cb) * size * es;
+            char* upper = M + ((size_t)cb * n + rb) * size * es;
+            // lower transposed in the buffer, upper transposed in lower, buffer copied in upper
+            plan->tile_kernel(lower, plan->buffer, rows, cols, n, size, es);
+            if (rb != cb) plan->tile_kernel(upper, lower, cols, rows, n, n, es);
+            for (int i = 0; i < cols; i++) {
+                memcpy(upper + (size_t)i * n * es, plan->buffer + (size_t)i * size * es, rows * es);
+            }
+        }
+    }
+}
+
+// Stripes of rows against the stripes of columns up to the diagonal, included for the Hermitian check
+static bool isSymmetricSequential(pt_plan* plan, const char* M, SymKernelAny kernel) {
+    const int n = plan->n;
+    const size_t es = plan->ops.size;
+
+    for (int i = 0; i < n; i += SYM_STRIPE) {
+        int rows = SYM_STRIPE < n - i ? SYM_STRIPE : n - i;
+        if (!kernel(M + (size_t)i * n * es, M + (size_t)i * es, rows, i + rows, n, n, plan->eps, es)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// MPI backend: the rows are scattered with derived data types and gathered back as columns, as in mpi_custom_datatypes.c
+
+#ifdef PARCO_MPI
+static MPI_Datatype elementTypeMPI(pt_dtype dtype, size_t size) {
+    const MPI_Datatype types[] = {MPI_DOUBLE, MPI_FLOAT, MPI_INT32_T, MPI_INT64_T, MPI_C_FLOAT_COMPLEX, MPI_C_DOUBLE_COMPLEX};
+    MPI_Datatype type_bytes;
+
+    if (dtype != PT_BYTES) return types[dtype];
+
+    MPI_Type_contiguous(size, MPI_BYTE, &type_bytes);
+    MPI_Type_commit(&type_bytes);
+    return type_bytes;
+}
+
+pt_plan* pt_plan_create_type_comm(int n, MPI_Comm comm, pt_dtype dtype, size_t element_size) {
+    pt_plan* plan = planAllocate(n, PT_MPI, dtype, element_size);
+    if (plan == NULL) return NULL;
+
+    MPI_Comm_dup(comm, &plan->comm);
+    MPI_Comm_size(plan->comm, &plan->size);
+    MPI_Comm_rank(plan->comm, &plan->rank);
+
+    int chunk = partitionRows(n, plan->size, plan->rank);
+    int triangle_chunk = triangleRows(n, plan->size, plan->rank);
+    int max_chunk = chunk > triangle_chunk ? chunk : triangle_chunk;
+    size_t es = plan->ops.size;
+
+    // Derived data types definition
+    MPI_Datatype type_column;
+
+    plan->type_element = elementTypeMPI(dtype, es);
+
+    MPI_Type_contiguous(n, plan->type_element, &plan->type_row_n);
+    MPI_Type_commit(&plan->type_row_n);
+
+    MPI_Type_vector(n, 1, n, plan->type_element, &type_column);
+    MPI_Type_create_resized(type_column, 0, es, &plan->type_column_n);
+    MPI_Type_commit(&plan->type_column_n);
+    MPI_Type_free(&type_column);
+
+    MPI_Type_vector(n, 1, chunk > 0 ? chunk : 1, plan->type_element, &type_column);
+    MPI_Type_create_resized(type_column, 0, es, &plan->type_column_chunk);
+    MPI_Type_commit(&plan->type_column_chunk);
+    MPI_Type_free(&type_column);
+
+    // Partitions and buffers
+    plan->row_counts = (int*)malloc(plan->size * sizeof(int));
+    plan->row_displs = (int*)malloc(plan->size * sizeof(int));
+    plan->triangle_counts = (int*)malloc(plan->size * sizeof(int));
+    plan->triangle_displs = (int*)malloc(plan->size * sizeof(int));
+    partitionCounts(n, plan->size, 1, plan->row_counts, plan->row_displs);
+    triangleCounts(n, plan->size, 1, plan->triangle_counts, plan->triangle_displs);
+
+    plan->temp_rows = (char*)allocBuffer((size_t)max_chunk * n * es);
+    plan->temp_columns = (char*)allocBuffer((size_t)max_chunk * n * es);
+
+    MPI_Type_contiguous(n, plan->type_row_n, &plan->type_matrix);
+    MPI_Type_commit(&plan->type_matrix);
+    plan->batch_counts = (int*)malloc(plan->size * sizeof(int));
+    plan->batch_displs = (int*)malloc(plan->size * sizeof(int));
+
+    if (!planApplyWisdom(plan)) {
+        pt_plan_destroy(plan);
+        return NULL;
+    }
+
+    return plan;
+}
+
+pt_plan* pt_plan_create_comm(int n, MPI_Comm comm) {
+    return pt_plan_create_type_comm(n, comm, PT_DOUBLE, sizeof(double));
+}
+
+static void transposeMPI(pt_plan* plan, const char* M, char* T) {
+    int n = plan->n;
+    int chunk = partitionRows(n, plan->size, plan->rank);
+    size_t es = plan->ops.size;
+
+    MPI_Scatterv(M, plan->row_counts, plan->row_displs, plan->type_row_n, plan->temp_rows, chunk, plan->type_row_n, 0, plan->comm);
+
+    // The slab of rows becomes a slab of columns, gathered in place into T (all of M has left rank 0, so T can alias M)
+    int size = planTileSize(plan);
+    for (int j = 0; j < n; j += size) {
+        int cols = size < n - j ? size : n - j;
+        plan->tile_kernel(plan->temp_rows + j * es, plan->temp_columns + (size_t)j * chunk * es, chunk, cols, n, chunk, es);
+    }
+
+    MPI_Gatherv(plan->temp_columns, chunk, plan->type_column_chunk, T, plan->row_counts, plan->row_displs, plan->type_column_n, 0, plan->comm);
+}
+
+static bool isSymmetricMPI(pt_plan* plan, const char* M, SymKernelAny kernel, bool diagonal) {
+    int n = plan->n;
+    int row_start = triangleStart(n, plan->size, plan->rank);
+    int chunk = triangleRows(n, plan->size, plan->rank);
+    int stripes = triangleStripes(n, plan->size);
+    size_t es = plan->ops.size;
+    bool doubles = plan->dtype == PT_DOUBLE;
+    SymmetryFlag flag;
+
+    MPI_Scatterv(M, plan->triangle_counts, plan->triangle_displs, plan->type_row_n, plan->temp_rows, chunk, plan->type_row_n, 0, plan->comm);
+    MPI_Scatterv(M, plan->triangle_counts, plan->triangle_displs, plan->type_column_n, plan->temp_columns, chunk, plan->type_row_n, 0, plan->comm);
+
+    symmetryFlagInit(&flag);
+    for (int s = 0; s < stripes; s++) {
+        if (!symmetryFlagPoll(&flag, plan->comm)) break;
+
+        // row and column of the same global index are compared up to the diagonal, a 1 x count tile for the other types
+        int end = triangleSplit(row_start, row_start + chunk, s + 1, stripes) - row_start;
+        for (int k = triangleSplit(row_start, row_start + chunk, s, stripes) - row_start; k < end && flag.local; k++) {
+            const char* row = plan->temp_rows + (size_t)k * n * es;
+            const char* column = plan->temp_columns + (size_t)k * n * es;
+            int count = row_start + k + (diagonal ? 1 : 0);
+            flag.local = doubles ? plan->equal_kernel((const double*)row, (const double*)column, count, plan->eps)
+                                 : kernel(row, column, 1, count, n, 1, plan->eps, es);
+        }
+    }
+
+    return symmetryFlagResult(&flag, plan->comm);
+}
+
+// Batches are partitioned in whole matrices, so that each one is transposed or checked by a single rank. Returns the
+// number of matrices of this rank, -1 if its buffers cannot hold them (on every rank).
+static int batchScatterMPI(pt_plan* plan, int count, const void* M) {
+    int chunk = partitionRows(count, plan->size, plan->rank);
+    int failed = 0;
+
+    if (chunk > plan->batch_capacity) {
+        size_t bytes = (size_t)chunk * plan->n * plan->n * plan->ops.size;
+        freeBuffer(plan->batch_in);
+        freeBuffer(plan->batch_out);
+        free(plan->batch_flags);
+        plan->batch_in = (char*)allocBuffer(bytes);
+        plan->batch_out = (char*)allocBuffer(bytes);
+        plan->batch_flags = (bool*)malloc(chunk * sizeof(bool));
+        plan->batch_capacity = chunk;
+        failed = plan->batch_in == NULL || plan->batch_out == NULL || plan->batch_flags == NULL;
+        if (failed) plan->batch_capacity = 0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, plan->comm);
+    if (failed) return -1;
+
+    partitionCounts(count, plan->size, 1, plan->batch_counts, plan->batch_displs);
+    MPI_Scatterv(M, plan->batch_counts, plan->batch_displs, plan->type_matrix, plan->batch_in, chunk, plan->type_matrix, 0, plan->comm);
+
+    return chunk;
+}
+#endif
+
+pt_plan* pt_plan_create_type(int n, pt_backend backend, pt_dtype dtype, size_t element_size) {
+    switch (backend) {
+        case PT_SEQUENTIAL: {
+            pt_plan* plan = planAllocate(n, PT_SEQUENTIAL, dtype, element_size);
+            if (plan != NULL && !planApplyWisdom(plan)) {
+                pt_plan_destroy(plan);
+                return NULL;
+            }
+            return plan;
+        }
+#ifdef PARCO_MPI
+        case PT_MPI:
+            return pt_plan_create_type_comm(n, MPI_COMM_WORLD, dtype, element_size);
+#endif
+        default:
+            return NULL;
+    }
+}
+
+pt_plan* pt_plan_create(int n, pt_backend backend) {
+    return pt_plan_create_type(n, backend, PT_DOUBLE, sizeof(double));
+}
+
+void pt_plan_set_tolerance(pt_plan* plan, double eps) {
+    plan->eps = eps;
+}
+
+void pt_transpose(pt_plan* plan, const void* M, void* T) {
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) {
+        transposeMPI(plan, (const char*)M, (char*)T);
+        return;
+    }
+#endif
+    if (T == M) {
+        transposeSequentialInPlace(plan, (char*)T);
+    } else {
+        transposeSequential(plan, (const char*)M, (char*)T);
+    }
+}
+
+bool pt_is_symmetric(pt_plan* plan, const void* M) {
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) return isSymmetricMPI(plan, (const char*)M, plan->ops.sym, false);
+#endif
+    return isSymmetricSequential(plan, (const char*)M, plan->ops.sym);
+}
+
+// The diagonal of a Hermitian matrix is real: it is compared with its own conjugate
+bool pt_is_hermitian(pt_plan* plan, const void* M) {
+#ifdef PARCO_MPI
+    bool complex_type = plan->dtype == PT_COMPLEX_FLOAT || plan->dtype == PT_COMPLEX_DOUBLE;
+    if (plan->backend == PT_MPI) return isSymmetricMPI(plan, (const char*)M, plan->ops.hermitian, complex_type);
+#endif
+    return isSymmetricSequential(plan, (const char*)M, plan->ops.hermitian);
+}
+
+int pt_transpose_batch(pt_plan* plan, int count, const void* M, void* T) {
+    size_t matrix = (size_t)plan->n * plan->n * plan->ops.size;
+
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) {
+        int chunk = batchScatterMPI(plan, count, M);
+        if (chunk == -1) return -1;
+
+        for (int b = 0; b < chunk; b++) {
+            transposeSequential(plan, plan->batch_in + b * matrix, plan->batch_out + b * matrix);
+        }
+        MPI_Gatherv(plan->batch_out, chunk, plan->type_matrix, T, plan->batch_counts, plan->batch_displs, plan->type_matrix, 0, plan->comm);
+        return 0;
+    }
+#endif
+    for (int b = 0; b < count; b++) {
+        pt_transpose(plan, (const char*)M + b * matrix, (char*)T + b * matrix);
+    }
+    return 0;
+}
+
+int pt_is_symmetric_batch(pt_plan* plan, int count, const void* M, bool* symmetric) {
+    size_t matrix = (size_t)plan->n * plan->n * plan->ops.size;
+    int result = 0;
+
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) {
+        int chunk = batchScatterMPI(plan, count, M);
+        if (chunk == -1) return -1;
+
+        for (int b = 0; b < chunk; b++) {
+            plan->batch_flags[b] = isSymmetricSequential(plan, plan->batch_in + b * matrix, plan->ops.sym);
+        }
+        MPI_Gatherv(plan->batch_flags, chunk, MPI_C_BOOL, symmetric, plan->batch_counts, plan->batch_displs, MPI_C_BOOL, 0, plan->comm);
+
+        if (plan->rank == 0) {
+            for (int b = 0; b < count; b++) result += symmetric[b];
+        }
+        return result;
+    }
+#endif
+    for (int b = 0; b < count; b++) {
+        symmetric[b] = isSymmetricSequential(plan, (const char*)M + b * matrix, plan->ops.sym);
+        result += symmetric[b];
+    }
+    return result;
+}
+
+// Seconds per transpose of the current algorithm, the slowest process for the MPI backend
+static double planTime(pt_plan* plan, const void* M, void* T) {
+    double seconds;
+    struct timespec s, e;
+
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) MPI_Barrier(plan->comm);
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &s);
+    for (int i = 0; i < TUNE_REPETITIONS; i++) pt_transpose(plan, M, T);
+    clock_gettime(CLOCK_MONOTONIC, &e);
+    seconds = elapsedTime(s, e) / TUNE_REPETITIONS;
+
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, plan->comm);
+#endif
+    return seconds;
+}
+
+int pt_plan_tune(pt_plan* plan) {
+    int n = plan->n;
+    bool root = true;
+    Wisdom best = {"", 0, -1};
+    int best_algorithm = ALGORITHM_SIMD;
+
+#ifdef PARCO_MPI
+    root = plan->backend != PT_MPI || plan->rank == 0;
+#endif
+    size_t bytes = (size_t)n * n * plan->ops.size;
+    char* M = root ? (char*)allocBuffer(bytes) : NULL;
+    char* T = root ? (char*)allocBuffer(bytes) : NULL;
+    // the elements are only moved, so any bit pattern times the transpose of any type
+    if (root && M != NULL) {
+        for (size_t k = 0; k < bytes; k++) M[k] = (char)(k * 131);
+    }
+
+    // a failed allocation is a failure of all the processes, which then take the same path
+    int failed = root && (M == NULL || T == NULL);
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, plan->comm);
+#endif
+    if (failed) {
+        freeBuffer(M);
+        freeBuffer(T);
+        return -1;
+    }
+
+    // one tile buffer for all the candidates, of the largest one
+    int largest = 0;
+    for (int c = 0; c < TUNE_BLOCK_SIZES && (c == 0 || tune_block_sizes[c] <= n); c++) largest = tune_block_sizes[c];
+    if (!planReserveBuffer(plan, largest < n ? largest : n)) failed = 1;
+
+    for (int a = 0; a < ALGORITHMS; a++) {
+        for (int c = 0; c < TUNE_BLOCK_SIZES && (c == 0 || tune_block_sizes[c] <= n); c++) {
+            if (!failed && !planSetAlgorithm(plan, a, tune_block_sizes[c])) failed = 1;
+            double seconds = failed ? -1 : planTime(plan, M, T);
+            if (seconds >= 0 && (best.seconds < 0 || seconds < best.seconds)) {
+                best_algorithm = a;
+                best.block_size = planTileSize(plan);  // n for the naive algorithm, as a single tile
+                best.seconds = seconds;
+            }
+            if (a == ALGORITHM_NAIVE) break;  // the block size is not a parameter of the naive algorithm
+        }
+    }
+    freeBuffer(M);
+    freeBuffer(T);
+
+    snprintf(best.algorithm, sizeof(best.algorithm), "%s", algorithm_names[best_algorithm]);
+    if (root && wisdomStore(planCode(plan), n, planProcesses(plan), &best) == -1) failed = 1;
+
+    // the buffer of the winner only
+    free(plan->buffer);
+    plan->buffer = NULL;
+    plan->buffer_size = 0;
+
+    return planSetAlgorithm(plan, best_algorithm, best.block_size) && !failed ? 0 : -1;
+}
+
+void pt_plan_destroy(pt_plan* plan) {
+    if (plan == NULL) return;
+
+#ifdef PARCO_MPI
+    if (plan->backend == PT_MPI) {
+        if (plan->dtype == PT_BYTES) MPI_Type_free(&plan->type_element);
+        MPI_Type_free(&plan->type_row_n);
+        MPI_Type_free(&plan->type_column_n);
+        MPI_Type_free(&plan->type_column_chunk);
+        MPI_Comm_free(&plan->comm);
+
+        free(plan->row_counts);
+        free(plan->row_displs);
+        free(plan->triangle_counts);
+        free(plan->triangle_displs);
+        freeBuffer(plan->temp_rows);
+        freeBuffer(plan->temp_columns);
+
+        MPI_Type_free(&plan->type_matrix);
+        free(plan->batch_counts);
+        free(plan->batch_displs);
+        freeBuffer(plan->batch_in);
+        freeBuffer(plan->batch_out);
+        free(plan->batch_flags);
+    }
+#endif
+
+    free(plan->buffer);
+    free(plan);
+
+    if (--plans_alive == 0) allocatorRelease();
+}
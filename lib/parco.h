@@ -0,0 +1,88 @@
+#ifndef PARCO_H
+#define PARCO_H
+
+#include <complex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef PARCO_MPI
+#include <mpi.h>
+#endif
+
+// libparco: square matrix transpose and symmetry check of row-major n x n matrices of doubles or of the other pt_dtype.
+// A plan is created once per shape, with the algorithm found by pt_plan_tune if the wisdom file has one, then executed
+// any number of times with no setup; plans are not thread-safe.
+
+typedef enum {
+    PT_SEQUENTIAL,  // blocked SIMD kernels on the calling thread
+    PT_MPI          // collective over the communicator of the plan, M and T significant on its rank 0 only
+} pt_backend;
+
+// Element types. The symmetry checks compare within the tolerance of the type (1e-6 for the double precision types,
+// 1e-4 for the single precision ones, exact for the integers and the records of PT_BYTES, compared byte by byte).
+typedef enum {
+    PT_DOUBLE,
+    PT_FLOAT,
+    PT_INT32,
+    PT_INT64,
+    PT_COMPLEX_FLOAT,
+    PT_COMPLEX_DOUBLE,
+    PT_BYTES  // records of element_size bytes
+} pt_dtype;
+
+#define pt_dtype_of(x) _Generic((x),         \
+    double: PT_DOUBLE,                       \
+    float: PT_FLOAT,                         \
+    int32_t: PT_INT32,                       \
+    int64_t: PT_INT64,                       \
+    float complex: PT_COMPLEX_FLOAT,         \
+    double complex: PT_COMPLEX_DOUBLE,       \
+    default: PT_BYTES)
+
+// Plan of the elements of the type of x, resolved at compile time: e.g. pt_plan_create_of(n, PT_MPI, (float)0) or, for
+// records, pt_plan_create_of(n, PT_SEQUENTIAL, (struct particle){0})
+#define pt_plan_create_of(n, backend, x) pt_plan_create_type((n), (backend), pt_dtype_of(x), sizeof(x))
+
+typedef struct pt_plan pt_plan;
+
+// Returns NULL if n is not positive, the allocation fails or the backend is not compiled in (PT_MPI needs PARCO_MPI).
+// PT_MPI plans are created on MPI_COMM_WORLD, which must be initialized: the call is collective.
+pt_plan* pt_plan_create(int n, pt_backend backend);
+
+// Plan of elements of dtype; element_size is only read for PT_BYTES, which needs it positive
+pt_plan* pt_plan_create_type(int n, pt_backend backend, pt_dtype dtype, size_t element_size);
+
+#ifdef PARCO_MPI
+// PT_MPI plan on a communicator of the application, duplicated by the plan
+pt_plan* pt_plan_create_comm(int n, MPI_Comm comm);
+pt_plan* pt_plan_create_type_comm(int n, MPI_Comm comm, pt_dtype dtype, size_t element_size);
+#endif
+
+// Benchmarks the local transpose algorithms (naive, blocked, SIMD) and block sizes on a generated matrix of the shape
+// and element size of the plan, keeps the fastest one and stores it in the wisdom file of this CPU (PARCO_WISDOM, default
+// "wisdom"), which the plans created later with the same shape read. Collective for PT_MPI plans, returns -1 on failure.
+int pt_plan_tune(pt_plan* plan);
+
+// T = M^T; T may be M itself, the transpose is then done in place
+void pt_transpose(pt_plan* plan, const void* M, void* T);
+
+// M == M^T within the tolerance, stopping at the first asymmetric pair
+bool pt_is_symmetric(pt_plan* plan, const void* M);
+
+// M == conj(M)^T within the tolerance, the same as pt_is_symmetric for the real types
+bool pt_is_hermitian(pt_plan* plan, const void* M);
+
+// Batches of count matrices of the plan shape stored one after the other, e.g. many small matrices in one call. The
+// MPI backend distributes whole matrices across the ranks, with one scatter and one gather per call. The transpose
+// returns -1 if the buffers of the batch cannot be allocated; the symmetry check returns the number of symmetric
+// matrices, with the result of each one in symmetric[count] (significant on rank 0 only for PT_MPI), or -1.
+int pt_transpose_batch(pt_plan* plan, int count, const void* M, void* T);
+int pt_is_symmetric_batch(pt_plan* plan, int count, const void* M, bool* symmetric);
+
+// Replaces the tolerance of the element type, 0 for exact comparisons (ignored by PT_BYTES)
+void pt_plan_set_tolerance(pt_plan* plan, double eps);
+
+void pt_plan_destroy(pt_plan* plan);
+
+#endif
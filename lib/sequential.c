@@ -5,93 +5,147 @@
 #include <time.h>
 
 #include "functions.h"
+#include "matrix_io.h"
+#include "simd.h"
 
 #define CODE "S"
 
-bool checkSym(const double* M, int n) {
-    bool check = true;
+SymKernel sym_kernel = checkTileSymScalar;  // selected at runtime by CPUID
 
-    for (int i = 0; i < n; i++) {
-        for (int j = i + 1; j < n; j++) {
-            if (fabs(M[i * n + j] - M[j * n + i]) > EPSILON) {
-                check = false;
-            }
+// Rows [i, i + rows) up to the diagonal are compared with the mirrored columns, stopping at the first mismatch
+bool checkSym(const double* M, int n) {
+    for (int i = 0; i < n; i += SYM_STRIPE) {
+        int rows = SYM_STRIPE < n - i ? SYM_STRIPE : n - i;
+        if (!sym_kernel(M + (size_t)i * n, M + i, rows, i + rows, n, n, EPSILON)) {
+            return false;
         }
     }
 
-    return check;
+    return true;
 }
 
 void matTranspose(const double* M, double* T, int n) {
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < n; j++) {
-            T[j * n + i] = M[i * n + j];
+            T[(size_t)j * n + i] = M[(size_t)i * n + j];
         }
     }
 }
 
-// The attribute is necessary to avoid the compiler optimization on the repetitions loops
-int __attribute__((optimize("O0"))) main(int argc, char** argv) {
-    int dim = 0;
+int main(int argc, char** argv) {
     int rep = 0;
     if (argc < 2) {
-        printf("Correct usage: program-name [M dimension as exponent of 2] [number of repetitions (default 5)]");
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [input=file] [output=file] [warmup=runs] [flush] [counters] [hugepages] [numa=local|interleave]");
         return 1;
     } else if (argc == 2) {
-        dim = atoi(argv[1]);
         rep = 500;
     } else {
-        dim = atoi(argv[1]);
         rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
     }
 
-    unsigned int n = pow(2, dim);
-    printf("Matrix dimension: %d\n", n);
-    printf("Repetitions: %d\n\n", rep);
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+    const char* input_name = getOption(argc, argv, "input");
+    const char* output_name = getOption(argc, argv, "output");
 
     // Variables declaration
-    struct timespec s1, s2, e1, e2;   // start, end times
+    BenchmarkStats s1, s2;            // statistics of the repetitions
+    CounterValues c1, c2;             // hardware counters of the repetitions
     double t1, t2, flops, bandwidth;  // execution times and performance metrics
     bool symmetric = false;           // symmetry check
-    double* M;                        // input matrix
+    double* M;                        // input matrix (mapped from the input file, read-only)
     double* T;                        // transposed matrix
-
-    // Matrices allocation
-    if (initMatrices(&M, &T, n) == -1) {
+    MatrixHeader header;              // header of the input file
+    size_t mapped = 0;                // length of the mapping of the input file
+
+    // Matrices allocation: the input file is mapped with no copy, its dimension replaces [n]
+    if (input_name != NULL) {
+        M = (double*)mapMatrixFile(input_name, &header, &mapped);
+        if (M == NULL) {
+            printf("Error in reading the input file!\n\n");
+            return -1;
+        }
+        n = header.rows;
+        T = (double*)allocBuffer((size_t)n * n * sizeof(double));
+    }
+    if ((input_name != NULL && T == NULL) || (input_name == NULL && initMatrices(&M, &T, n) == -1)) {
         printf("Error in allocating matrices!\n\n");
         return -1;
     }
 
-    // Sequential execution
-    clock_gettime(CLOCK_MONOTONIC, &s1);
-    for (int i = 0; i < rep; i++) symmetric = checkSym(M, n);
-    clock_gettime(CLOCK_MONOTONIC, &e1);
+    printf("Matrix dimension: %d\n", n);
+    printf("Repetitions: %d\n\n", rep);
 
-    clock_gettime(CLOCK_MONOTONIC, &s2);
-    for (int i = 0; i < rep; i++) matTranspose(M, T, n);
-    clock_gettime(CLOCK_MONOTONIC, &e2);
+    sym_kernel = selectSymKernel();
+    printf("Symmetry kernel: %s\n\n", simdName);
+
+    // Sequential execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, true);
+
+    for (int i = 0; i < bench.warmup; i++) symmetric = checkSym(M, n);
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        countersStart();
+        symmetric = checkSym(M, n);
+        doNotOptimize(symmetric);
+        countersStop();
+        benchmarkStop(&bench, i);
+    }
+    s1 = benchmarkStats(&bench);
+    c1 = countersCollect(rep);
+
+    for (int i = 0; i < bench.warmup; i++) matTranspose(M, T, n);
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        countersStart();
+        matTranspose(M, T, n);
+        countersStop();
+        benchmarkStop(&bench, i);
+    }
+    s2 = benchmarkStats(&bench);
+    c2 = countersCollect(rep);
     // --------------------------------
 
     // Results printing and saving
-    t1 = elapsedTime(s1, e1) / rep;
-    t2 = elapsedTime(s2, e2) / rep;
+    t1 = s1.mean;
+    t2 = s2.mean;
 
-    flops = (double)((n * n) / 2 - n) / t1;
-    bandwidth = (double)(2 * n * n * sizeof(double)) / t2;
+    flops = ((double)n * n / 2 - n) / t1;
+    bandwidth = (double)(2 * (size_t)n * n * sizeof(double)) / t2;
 
     printf("Sequential execution: symmetry: %s\n", symmetric ? "true" : "false");
     printf("checkSym:\t%.9f seconds\t%10.4g GFLOPS\n", t1, flops * 1e-9);
-    printf("matTranspose:\t%.9f seconds\t%10.4g GB/s\n\n", t2, bandwidth * 1e-9);
+    printBenchmarkStats(&s1);
+    if (counters.enabled) printCounterValues(&c1);
+    printf("matTranspose:\t%.9f seconds\t%10.4g GB/s\n", t2, bandwidth * 1e-9);
+    printBenchmarkStats(&s2);
+    if (counters.enabled) printCounterValues(&c2);
+    printf("\n");
 
     testResults(M, T, n);
 
-    if (saveResultsMPI(CODE, n, 1, t1, t1, t2, t2) == -1) {
+    if (output_name != NULL && writeMatrixFile(output_name, T, n, true) == -1) {
+        printf("Error in writing the output file!\n\n");
+    }
+
+    if (saveResultsMPI(CODE, n, 1, 1, &s1, t1, &s2, t2, &c1, &c2) == -1) {
         printf("Error in saving results!\n\n");
     }
 
     // Matrices deallocation
-    free(M);
-    free(T);
+    if (input_name != NULL) {
+        unmapMatrixFile(M, mapped);
+    } else {
+        freeBuffer(M);
+    }
+    freeBuffer(T);
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
 
     return 0;
 }
\ No newline at end of file
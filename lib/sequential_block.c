@@ -1,4 +1,3 @@
-#include <immintrin.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -6,83 +5,181 @@
 #include <time.h>
 
 #include "functions.h"
+#include "simd.h"
+#include "wisdom.h"
 
 #define CODE "SB"
+#define CODE_IN_PLACE "SBI"
+
+#define BLOCK_SIZE 32       // default block size, without wisdom or bs= option
+#define TUNE_REPETITIONS 4  // even, so that tuning leaves the in-place input as it was
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+
+// The last row and column of blocks are narrower when n is not a multiple of the block size
+void matTransposeBlock(const double* M, double* T, int n, int size) {
+    for (int rb = 0; rb * size < n; rb++) {  // row blocks indexing
+        const int rows = size < n - rb * size ? size : n - rb * size;
+        for (int cb = 0; cb * size < n; cb++) {  // column blocks indexing
+            const int cols = size < n - cb * size ? size : n - cb * size;
+            const double* source = M + ((size_t)rb * n + cb) * size;     // block matrix of lower triangular part
+            double* destination = T + ((size_t)cb * n + rb) * size;      // block matrix of higher triangular part
+            tile_kernel(source, destination, rows, cols, n, n);  // transposing
+        }
+    }
+}
 
-#define BLOCK_SIZE 32
-
-void matTransposeBlock(const double* M, double* T, int n) {
-    const int size = BLOCK_SIZE < n ? BLOCK_SIZE : n;
-
-    for (int rb = 0; rb < n / size; rb++) {                   // row blocks indexing
-        for (int cb = 0; cb < n / size; cb++) {               // column blocks indexing
-            const double* source = M + (rb * n + cb) * size;  // block matrix of lower triangular part
-            double* destination = T + (cb * n + rb) * size;   // block matrix of higher triangular part
-            for (int i = 0; i < size; i++) {                  // transposing
-                for (int j = 0; j < size; j++) {
-                    destination[i * n + j] = source[j * n + i];
-                }
+// Square in-place transpose: diagonal tiles are transposed on themselves, off-diagonal tiles swapped with their mirror
+void matTransposeBlockInPlace(double* M, int n, int size, double* buffer) {
+    for (int rb = 0; rb * size < n; rb++) {  // row blocks indexing
+        const int rows = size < n - rb * size ? size : n - rb * size;
+        for (int cb = 0; cb <= rb; cb++) {  // column blocks of the lower triangular part
+            const int cols = size < n - cb * size ? size : n - cb * size;
+            double* lower = M + ((size_t)rb * n + cb) * size;  // block matrix of lower triangular part, rows x cols
+            double* upper = M + ((size_t)cb * n + rb) * size;  // block matrix of higher triangular part, cols x rows
+            // lower transposed in the buffer, upper transposed in lower, buffer copied in upper
+            tile_kernel(lower, buffer, rows, cols, n, size);
+            if (rb != cb) tile_kernel(upper, lower, cols, rows, n, n);
+            for (int i = 0; i < cols; i++) {
+                memcpy(upper + (size_t)i * n, buffer + (size_t)i * size, rows * sizeof(double));
             }
         }
     }
 }
 
-// The attribute is necessary to avoid the compiler optimization on the repetitions loops
-int __attribute__((optimize("O0"))) main(int argc, char** argv) {
-    int dim = 0;
+// Matrices of a tuning run
+typedef struct {
+    double *M, *T;
+    int n;
+} TuneArgs;
+
+double tuneRun(int size, void* arg) {
+    TuneArgs* args = (TuneArgs*)arg;
+    double* buffer = (double*)allocBuffer((size_t)size * size * sizeof(double));
+    struct timespec s, e;
+
+    clock_gettime(CLOCK_MONOTONIC, &s);
+    for (int i = 0; i < TUNE_REPETITIONS; i++) {
+        if (args->T == NULL) {
+            matTransposeBlockInPlace(args->M, args->n, size, buffer);
+        } else {
+            matTransposeBlock(args->M, args->T, args->n, size);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &e);
+
+    freeBuffer(buffer);
+    return elapsedTime(s, e) / TUNE_REPETITIONS;
+}
+
+int main(int argc, char** argv) {
     int rep = 0;
     if (argc < 2) {
-        printf("Correct usage: program-name [M dimension as exponent of 2] [number of repetitions (default 5)]");
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [inplace] [bs=block size] [tune] [warmup=runs] [flush] [counters] [hugepages] [numa=local|interleave]");
         return 1;
     } else if (argc == 2) {
-        dim = atoi(argv[1]);
         rep = 500;
     } else {
-        dim = atoi(argv[1]);
         rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
     }
 
-    unsigned int n = pow(2, dim);
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    bool in_place = getOption(argc, argv, "inplace") != NULL;
+    bool tune = getOption(argc, argv, "tune") != NULL;
     printf("Matrix dimension: %d\n\n", n);
     printf("Repetitions: %d\n\n", rep);
+    printf("In-place: %s\n\n", in_place ? "true" : "false");
 
     // Variables declaration
-    struct timespec s1, s2, e1, e2;   // start, end times
-    double t1, t2, flops, bandwidth;  // execution times and performance metrics
-    bool symmetric = false;           // symmetry check
-    double* M;                        // input matrix
-    double* T;                        // transposed matrix
+    BenchmarkStats s2;     // statistics of the repetitions
+    CounterValues c2;      // hardware counters of the repetitions
+    double t2, bandwidth;  // execution time and performance metric
+    double* M;             // input matrix
+    double* T = NULL;      // transposed matrix (not allocated in-place)
+    double* buffer;        // one tile, resident in L1 (in-place only)
 
     // Matrices allocation
-    if (initMatrices(&M, &T, n) == -1) {
+    if ((in_place ? initMatrix(&M, n) : initMatrices(&M, &T, n)) == -1) {
         printf("Error in allocating matrices!\n\n");
         return -1;
     }
 
-    // Execution
-    clock_gettime(CLOCK_MONOTONIC, &s2);
-    for (int i = 0; i < rep; i++) matTransposeBlock(M, T, n);
-    clock_gettime(CLOCK_MONOTONIC, &e2);
+    tile_kernel = selectTileKernel();
+    printf("Tile kernel: %s\n\n", simdName);
+
+    // Block size: bs= option, otherwise tuned on this machine, otherwise from the wisdom file of this CPU
+    const char* code = in_place ? CODE_IN_PLACE : CODE;
+    int size;
+    if (getOption(argc, argv, "bs") != NULL && atoi(getOption(argc, argv, "bs")) > 0) {
+        size = atoi(getOption(argc, argv, "bs"));
+        size = size < (int)n ? size : (int)n;
+    } else if (tune) {
+        TuneArgs args = {M, T, n};
+        size = tuneBlockSize(code, n, 1, true, tuneRun, &args);
+    } else {
+        size = wisdomBlockSize(code, n, 1, BLOCK_SIZE);
+    }
+    printf("Block size: %d\n\n", size);
+    buffer = (double*)allocBuffer((size_t)size * size * sizeof(double));
+
+    // Execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, true);
+
+    if (in_place) {
+        for (int i = 0; i < bench.warmup; i++) matTransposeBlockInPlace(M, n, size, buffer);
+        countersReset();
+        for (int i = 0; i < rep; i++) {
+            benchmarkStart(&bench);
+            countersStart();
+            matTransposeBlockInPlace(M, n, size, buffer);
+            countersStop();
+            benchmarkStop(&bench, i);
+        }
+    } else {
+        for (int i = 0; i < bench.warmup; i++) matTransposeBlock(M, T, n, size);
+        countersReset();
+        for (int i = 0; i < rep; i++) {
+            benchmarkStart(&bench);
+            countersStart();
+            matTransposeBlock(M, T, n, size);
+            countersStop();
+            benchmarkStop(&bench, i);
+        }
+    }
+    s2 = benchmarkStats(&bench);
+    c2 = countersCollect(rep);
     // --------------------------------
 
-    // Results printing and saving
-    t1 = elapsedTime(s1, e1) / rep;
-    t2 = elapsedTime(s2, e2) / rep;
+    // Results printing and saving: there is no symmetry check, whose columns are left empty
+    t2 = s2.mean;
 
-    const int size = BLOCK_SIZE < n ? BLOCK_SIZE : n;
-    flops = (double)(n/size * (n/size + 1) / 2 * size * size) / t1;
-    bandwidth = (double)(2 * n * n * sizeof(double)) / t2;
+    bandwidth = (double)(2 * (size_t)n * n * sizeof(double)) / t2;
 
     printf("Sequential execution:\n");
-    printf("matTransposeBlock:\t%.9f seconds\t%10.4g GB/s\n\n", t2, bandwidth * 1e-9);
+    printf("%s:\t%.9f seconds\t%10.4g GB/s\n", in_place ? "matTransposeBlockInPlace" : "matTransposeBlock", t2, bandwidth * 1e-9);
+    printBenchmarkStats(&s2);
+    if (counters.enabled) printCounterValues(&c2);
+    printf("\n");
+
+    if (in_place) {
+        testResultsInPlace(M, n, rep + bench.warmup);
+    } else {
+        testResultsBlock(M, T, n);
+    }
 
-    if (saveResultsMPI(CODE, n, 1, t1, t1, t2, t2) == -1) {
+    if (saveResultsMPI(in_place ? CODE_IN_PLACE : CODE, n, 1, 1, NULL, 0, &s2, t2, NULL, &c2) == -1) {
         printf("Error in saving results!\n\n");
     }
 
     // Matrices deallocation
-    free(M);
-    free(T);
+    freeBuffer(M);
+    freeBuffer(T);
+    freeBuffer(buffer);
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
 
     return 0;
 }
\ No newline at end of file
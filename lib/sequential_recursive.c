@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "functions.h"
+#include "simd.h"
+
+#define CODE "SR"
+
+// Leaf edge only amortizes the recursion overhead, it is not tuned on any cache size
+#define LEAF_SIZE 16
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+
+// Symmetry check of the part of rows [r0, r1) x columns [c0, c1) lying strictly under the diagonal
+bool checkSymRecursive(const double* M, int n, int r0, int r1, int c0, int c1) {
+    if (c0 >= r1 - 1) return true;  // block entirely on or over the diagonal
+
+    if (r1 - r0 <= LEAF_SIZE && c1 - c0 <= LEAF_SIZE) {
+        bool check = true;
+        for (int i = r0; i < r1; i++) {
+            for (int j = c0; j < c1 && j < i; j++) {
+                if (fabs(M[i * n + j] - M[j * n + i]) > EPSILON) {
+                    check = false;
+                }
+            }
+        }
+        return check;
+    }
+
+    bool first, second;
+    if (r1 - r0 >= c1 - c0) {  // splitting the larger dimension
+        int rm = r0 + (r1 - r0) / 2;
+        first = checkSymRecursive(M, n, r0, rm, c0, c1);
+        second = checkSymRecursive(M, n, rm, r1, c0, c1);
+    } else {
+        int cm = c0 + (c1 - c0) / 2;
+        first = checkSymRecursive(M, n, r0, r1, c0, cm);
+        second = checkSymRecursive(M, n, r0, r1, cm, c1);
+    }
+
+    return first && second;
+}
+
+// Transpose of rows [r0, r1) x columns [c0, c1) of M into T
+void matTransposeRecursive(const double* M, double* T, int n, int r0, int r1, int c0, int c1) {
+    if (r1 - r0 <= LEAF_SIZE && c1 - c0 <= LEAF_SIZE) {
+        tile_kernel(M + r0 * n + c0, T + c0 * n + r0, r1 - r0, c1 - c0, n, n);
+        return;
+    }
+
+    if (r1 - r0 >= c1 - c0) {  // splitting the larger dimension
+        int rm = r0 + (r1 - r0) / 2;
+        matTransposeRecursive(M, T, n, r0, rm, c0, c1);
+        matTransposeRecursive(M, T, n, rm, r1, c0, c1);
+    } else {
+        int cm = c0 + (c1 - c0) / 2;
+        matTransposeRecursive(M, T, n, r0, r1, c0, cm);
+        matTransposeRecursive(M, T, n, r0, r1, cm, c1);
+    }
+}
+
+int main(int argc, char** argv) {
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [warmup=runs] [flush] [counters] [hugepages] [numa=local|interleave]");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+    printf("Matrix dimension: %d\n", n);
+    printf("Repetitions: %d\n\n", rep);
+
+    // Variables declaration
+    BenchmarkStats s1, s2;            // statistics of the repetitions
+    CounterValues c1, c2;             // hardware counters of the repetitions
+    double t1, t2, flops, bandwidth;  // execution times and performance metrics
+    bool symmetric = false;           // symmetry check
+    double* M;                        // input matrix
+    double* T;                        // transposed matrix
+
+    // Matrices allocation
+    if (initMatrices(&M, &T, n) == -1) {
+        printf("Error in allocating matrices!\n\n");
+        return -1;
+    }
+
+    tile_kernel = selectTileKernel();
+    printf("Tile kernel: %s\n\n", simdName);
+
+    // Sequential execution: warm-up runs, then every repetition timed on its own
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, true);
+
+    for (int i = 0; i < bench.warmup; i++) symmetric = checkSymRecursive(M, n, 0, n, 0, n);
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        countersStart();
+        symmetric = checkSymRecursive(M, n, 0, n, 0, n);
+        doNotOptimize(symmetric);
+        countersStop();
+        benchmarkStop(&bench, i);
+    }
+    s1 = benchmarkStats(&bench);
+    c1 = countersCollect(rep);
+
+    for (int i = 0; i < bench.warmup; i++) matTransposeRecursive(M, T, n, 0, n, 0, n);
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        countersStart();
+        matTransposeRecursive(M, T, n, 0, n, 0, n);
+        countersStop();
+        benchmarkStop(&bench, i);
+    }
+    s2 = benchmarkStats(&bench);
+    c2 = countersCollect(rep);
+    // --------------------------------
+
+    // Results printing and saving
+    t1 = s1.mean;
+    t2 = s2.mean;
+
+    flops = (double)((n * n) / 2 - n) / t1;
+    bandwidth = (double)(2 * n * n * sizeof(double)) / t2;
+
+    printf("Sequential execution: symmetry: %s\n", symmetric ? "true" : "false");
+    printf("checkSymRecursive:\t%.9f seconds\t%10.4g GFLOPS\n", t1, flops * 1e-9);
+    printBenchmarkStats(&s1);
+    if (counters.enabled) printCounterValues(&c1);
+    printf("matTransposeRecursive:\t%.9f seconds\t%10.4g GB/s\n", t2, bandwidth * 1e-9);
+    printBenchmarkStats(&s2);
+    if (counters.enabled) printCounterValues(&c2);
+    printf("\n");
+
+    testResults(M, T, n);
+
+    if (saveResultsMPI(CODE, n, 1, 1, &s1, t1, &s2, t2, &c1, &c2) == -1) {
+        printf("Error in saving results!\n\n");
+    }
+
+    // Matrices deallocation
+    freeBuffer(M);
+    freeBuffer(T);
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    return 0;
+}
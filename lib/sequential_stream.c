@@ -0,0 +1,397 @@
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "functions.h"
+#include "matrix_io.h"
+#include "simd.h"
+
+#define CODE "SO"
+
+#define BLOCK_SIZE 32        // blocks of the in-memory transpose of a tile
+#define MEMORY_BUDGET 256    // MB of tile and stripe buffers, without mem= option
+#define FILE_NAME_M "M.bin"  // generated input, without input= option
+#define FILE_NAME_T "T.bin"  // transposed output, without output= option
+
+TileKernel tile_kernel = transposeTileScalar;  // selected at runtime by CPUID
+SymKernel sym_kernel = checkTileSymScalar;     // selected at runtime by CPUID
+
+// Whole transfers, repeating the short reads and writes of large requests
+int preadAll(int fd, void* buffer, size_t bytes, off_t offset) {
+    while (bytes > 0) {
+        ssize_t done = pread(fd, buffer, bytes, offset);
+        if (done <= 0) return -1;
+        buffer = (char*)buffer + done;
+        bytes -= done;
+        offset += done;
+    }
+    return 0;
+}
+
+int pwriteAll(int fd, const void* buffer, size_t bytes, off_t offset) {
+    while (bytes > 0) {
+        ssize_t done = pwrite(fd, buffer, bytes, offset);
+        if (done <= 0) return -1;
+        buffer = (const char*)buffer + done;
+        bytes -= done;
+        offset += done;
+    }
+    return 0;
+}
+
+// A square tile of M goes through the slots in order: read by the reader thread, transposed by the main thread, written
+// by the writer thread. Two slots let the read of the next tile and the write of the previous one overlap the transpose
+// of the current one. The rows of a tile are segments of rows of M and the rows of its transpose segments of rows of T,
+// so every read and write moves tile elements however large n is.
+typedef enum { SLOT_EMPTY, SLOT_READ, SLOT_TRANSPOSED } SlotState;
+
+typedef struct {
+    double* in;   // tile of M, rows x cols stored contiguously
+    double* out;  // its transpose, cols x rows: a segment of cols rows of T
+    SlotState state;
+} Slot;
+
+typedef struct {
+    int input, output;  // file descriptors of M and T, whose elements start after a header
+    int n;
+    int tile;   // side of the tiles, the last row and column of tiles may be narrower
+    int tiles;  // tiles per side, tiles * tiles in all, taken by rows of tiles
+    Slot slots[2];
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    bool error;  // a failed transfer, the tiles keep flowing so that no stage waits forever
+} Stream;
+
+int tileSide(Stream* stream, int t) {
+    int side = stream->n - t * stream->tile;
+    return side < stream->tile ? side : stream->tile;
+}
+
+void slotWait(Stream* stream, Slot* slot, SlotState state) {
+    pthread_mutex_lock(&stream->mutex);
+    while (slot->state != state) pthread_cond_wait(&stream->changed, &stream->mutex);
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+void slotSet(Stream* stream, Slot* slot, SlotState state, bool failed) {
+    pthread_mutex_lock(&stream->mutex);
+    slot->state = state;
+    stream->error = stream->error || failed;
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+void* readerThread(void* arg) {
+    Stream* stream = (Stream*)arg;
+    int n = stream->n;
+
+    for (int t = 0; t < stream->tiles * stream->tiles; t++) {
+        Slot* slot = &stream->slots[t % 2];
+        int ti = t / stream->tiles, tj = t % stream->tiles;
+        int rows = tileSide(stream, ti), cols = tileSide(stream, tj);
+        bool failed = false;
+        slotWait(stream, slot, SLOT_EMPTY);
+
+        // row i of the tile is the segment [tj * tile, tj * tile + cols) of row ti * tile + i of M
+        for (int i = 0; i < rows && !failed; i++) {
+            off_t offset = MATRIX_HEADER_SIZE + ((off_t)(ti * stream->tile + i) * n + (off_t)tj * stream->tile) * sizeof(double);
+            failed = preadAll(stream->input, slot->in + (size_t)i * cols, cols * sizeof(double), offset) == -1;
+        }
+        slotSet(stream, slot, SLOT_READ, failed);
+    }
+    return NULL;
+}
+
+void* writerThread(void* arg) {
+    Stream* stream = (Stream*)arg;
+    int n = stream->n;
+
+    for (int t = 0; t < stream->tiles * stream->tiles; t++) {
+        Slot* slot = &stream->slots[t % 2];
+        int ti = t / stream->tiles, tj = t % stream->tiles;
+        int rows = tileSide(stream, ti), cols = tileSide(stream, tj);
+        bool failed = false;
+        slotWait(stream, slot, SLOT_TRANSPOSED);
+
+        // row j of the transposed tile is the segment [ti * tile, ti * tile + rows) of row tj * tile + j of T
+        for (int j = 0; j < cols && !failed; j++) {
+            off_t offset = MATRIX_HEADER_SIZE + ((off_t)(tj * stream->tile + j) * n + (off_t)ti * stream->tile) * sizeof(double);
+            failed = pwriteAll(stream->output, slot->out + (size_t)j * rows, rows * sizeof(double), offset) == -1;
+        }
+        slotSet(stream, slot, SLOT_EMPTY, failed);
+    }
+    return NULL;
+}
+
+int matTransposeStream(Stream* stream) {
+    pthread_t reader, writer;
+
+    stream->error = false;
+    stream->slots[0].state = stream->slots[1].state = SLOT_EMPTY;
+    pthread_create(&reader, NULL, readerThread, stream);
+    pthread_create(&writer, NULL, writerThread, stream);
+
+    for (int t = 0; t < stream->tiles * stream->tiles; t++) {
+        Slot* slot = &stream->slots[t % 2];
+        int rows = tileSide(stream, t / stream->tiles), cols = tileSide(stream, t % stream->tiles);
+        slotWait(stream, slot, SLOT_READ);
+
+        for (int i = 0; i < rows; i += BLOCK_SIZE) {
+            for (int j = 0; j < cols; j += BLOCK_SIZE) {
+                int block_rows = BLOCK_SIZE < rows - i ? BLOCK_SIZE : rows - i;
+                int block_cols = BLOCK_SIZE < cols - j ? BLOCK_SIZE : cols - j;
+                tile_kernel(slot->in + (size_t)i * cols + j, slot->out + (size_t)j * rows + i, block_rows, block_cols, cols, rows);
+            }
+        }
+        slotSet(stream, slot, SLOT_TRANSPOSED, false);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    return stream->error ? -1 : 0;
+}
+
+// Every stripe of rows is compared up to the diagonal with the mirrored blocks of the previous stripes, read one at a
+// time, so only one stripe and one block are in memory. Returns -1 if a read fails.
+int checkSymStream(int input, int n, int stripe_rows, double* stripe, double* mirror) {
+    for (int i0 = 0; i0 < n; i0 += stripe_rows) {
+        int rows = stripe_rows < n - i0 ? stripe_rows : n - i0;
+        if (preadAll(input, stripe, (size_t)rows * n * sizeof(double), MATRIX_HEADER_SIZE + (off_t)i0 * n * sizeof(double)) == -1) return -1;
+
+        // diagonal block, inside the stripe
+        if (!sym_kernel(stripe + i0, stripe + i0, rows, rows, n, n, EPSILON)) return 0;
+
+        for (int j0 = 0; j0 < i0; j0 += stripe_rows) {
+            int cols = stripe_rows < i0 - j0 ? stripe_rows : i0 - j0;
+
+            // block of the rows [j0, j0 + cols) and columns [i0, i0 + rows), cols x rows
+            for (int j = 0; j < cols; j++) {
+                off_t offset = MATRIX_HEADER_SIZE + ((off_t)(j0 + j) * n + i0) * sizeof(double);
+                if (preadAll(input, mirror + (size_t)j * rows, rows * sizeof(double), offset) == -1) return -1;
+            }
+            if (!sym_kernel(stripe + j0, mirror, rows, cols, n, rows, EPSILON)) return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Writes the generated input stripe by stripe, never holding the whole matrix
+int writeMatrixStream(int output, int n, int stripe_rows, double* stripe) {
+    MatrixHeader header;
+    matrixHeaderInit(&header, n, n, MATRIX_ROW_MAJOR);
+    if (pwriteAll(output, &header, sizeof(MatrixHeader), 0) == -1) return -1;
+
+    for (int i0 = 0; i0 < n; i0 += stripe_rows) {
+        int rows = stripe_rows < n - i0 ? stripe_rows : n - i0;
+        fillSlab(stripe, n, i0, rows);
+        if (pwriteAll(output, stripe, (size_t)rows * n * sizeof(double), MATRIX_HEADER_SIZE + (off_t)i0 * n * sizeof(double)) == -1) return -1;
+    }
+    return 0;
+}
+
+// Checks the transposed file stripe by stripe against the regenerated input
+void testResultsStream(int input, int n, int stripe_rows, double* stripe) {
+    bool transposed = true;
+
+    for (int i0 = 0; i0 < n && transposed; i0 += stripe_rows) {
+        int rows = stripe_rows < n - i0 ? stripe_rows : n - i0;
+        if (preadAll(input, stripe, (size_t)rows * n * sizeof(double), MATRIX_HEADER_SIZE + (off_t)i0 * n * sizeof(double)) == -1) {
+            transposed = false;
+        }
+        for (int i = 0; i < rows && transposed; i++) {
+            for (int j = 0; j < n; j++) {
+                if (stripe[(size_t)i * n + j] != randomEntry(matrix_seed, n, j, i0 + i)) transposed = false;
+            }
+        }
+    }
+
+    printf("Tested results: transposed %s.\n\n", transposed ? "correct" : "incorrect");
+}
+
+int main(int argc, char** argv) {
+    int rep = 0;
+    if (argc < 2) {
+        printf("Correct usage: program-name [M dimension as exponent of 2, or n=size] [number of repetitions (default 5)] [symmetric] [input=file] [output=file] [mem=MB] [warmup=runs] [flush] [counters] [hugepages] [numa=local|interleave]\n");
+        return 1;
+    } else if (argc == 2) {
+        rep = 500;
+    } else {
+        rep = atoi(argv[2]) > 0 ? atoi(argv[2]) : 500;
+    }
+
+    unsigned int n = parseDimension(argv[1]);
+    allocatorInit(argc, argv);
+    matrix_symmetric = getOption(argc, argv, "symmetric") != NULL;
+    const char* input_name = getOption(argc, argv, "input");
+    const char* output_name = getOption(argc, argv, "output");
+    size_t budget = (size_t)(getOption(argc, argv, "mem") != NULL ? atoi(getOption(argc, argv, "mem")) : MEMORY_BUDGET) << 20;
+    bool generated = input_name == NULL;
+
+    // Variables declaration
+    BenchmarkStats s1, s2;            // statistics of the repetitions
+    CounterValues c1, c2;             // hardware counters of the repetitions
+    double t1, t2, flops, bandwidth;  // execution times and performance metrics
+    int symmetric = 0;                // symmetry check, -1 on a failed read
+    int transposed = 0;               // transpose result, -1 on a failed transfer
+    Stream stream;                    // transpose pipeline
+    double *stripe, *mirror;          // symmetry check buffers, a stripe of rows and a mirrored block
+    MatrixHeader header;              // header of the input and output files
+
+    // Files opening: without input= the input is generated in a file, stripe by stripe
+    if (generated) input_name = FILE_NAME_M;
+    if (output_name == NULL) output_name = FILE_NAME_T;
+    stream.input = open(input_name, generated ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+    stream.output = open(output_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (stream.input == -1 || stream.output == -1) {
+        printf("Error in opening files!\n\n");
+        return -1;
+    }
+
+    // The dimension of the input file replaces [n] (its checksum is not verified, it would take one more pass)
+    if (!generated) {
+        if (preadAll(stream.input, &header, sizeof(MatrixHeader), 0) == -1 || !matrixHeaderValid(&header)) {
+            printf("Error in reading the input file!\n\n");
+            return -1;
+        }
+        n = header.rows;
+    }
+    matrixHeaderInit(&header, n, n, MATRIX_ROW_MAJOR);
+    if (pwriteAll(stream.output, &header, sizeof(MatrixHeader), 0) == -1) {
+        printf("Error in writing the output file!\n\n");
+        return -1;
+    }
+
+    printf("Matrix dimension: %d\n", n);
+    printf("Repetitions: %d\n", rep);
+    printf("Memory budget: %zu MB\n\n", budget >> 20);
+
+    // Half of the budget each: the transpose holds two slots of a tile and its transpose, the symmetry check a stripe of
+    // rows and a block
+    stream.n = n;
+    size_t tile = (size_t)sqrt(budget / (8 * sizeof(double)));
+    stream.tile = (int)(tile < 1 ? 1 : tile < n ? tile : n);
+    stream.tiles = (n + stream.tile - 1) / stream.tile;
+    size_t check_stripe = budget / (4 * (size_t)n * sizeof(double));
+    int check_rows = (int)(check_stripe < 1 ? 1 : check_stripe < n ? check_stripe : n);
+    printf("Tile: %d x %d (transpose), stripe rows: %d (symmetry check)\n\n", stream.tile, stream.tile, check_rows);
+
+    // Buffers allocation
+    for (int k = 0; k < 2; k++) {
+        stream.slots[k].in = (double*)allocBuffer((size_t)stream.tile * stream.tile * sizeof(double));
+        stream.slots[k].out = (double*)allocBuffer((size_t)stream.tile * stream.tile * sizeof(double));
+    }
+    stripe = (double*)allocBuffer((size_t)check_rows * n * sizeof(double));
+    mirror = (double*)allocBuffer((size_t)check_rows * check_rows * sizeof(double));
+    pthread_mutex_init(&stream.mutex, NULL);
+    pthread_cond_init(&stream.changed, NULL);
+
+    if (stream.slots[0].in == NULL || stream.slots[0].out == NULL || stream.slots[1].in == NULL ||
+        stream.slots[1].out == NULL || stripe == NULL || mirror == NULL) {
+        printf("Error in allocating matrices!\n\n");
+        return -1;
+    }
+
+    if (generated) {
+        matrix_seed = time(0);
+        if (writeMatrixStream(stream.input, n, check_rows, stripe) == -1) {
+            printf("Error in writing the input file!\n\n");
+            return -1;
+        }
+    }
+    posix_fadvise(stream.input, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    tile_kernel = selectTileKernel();
+    sym_kernel = selectSymKernel();
+    printf("Tile and symmetry kernels: %s\n\n", simdName);
+
+    // Sequential execution: warm-up runs, then every repetition timed on its own (the file transfers overlap the
+    // transposes in the pipeline threads)
+    Benchmark bench = benchmarkInit(argc, argv, rep);
+    countersInit(argc, argv, true);
+
+    for (int i = 0; i < bench.warmup; i++) symmetric = checkSymStream(stream.input, n, check_rows, stripe, mirror);
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        countersStart();
+        symmetric = checkSymStream(stream.input, n, check_rows, stripe, mirror);
+        doNotOptimize(symmetric);
+        countersStop();
+        benchmarkStop(&bench, i);
+    }
+    s1 = benchmarkStats(&bench);
+    c1 = countersCollect(rep);
+
+    for (int i = 0; i < bench.warmup; i++) transposed = matTransposeStream(&stream);
+    countersReset();
+    for (int i = 0; i < rep; i++) {
+        benchmarkStart(&bench);
+        countersStart();
+        transposed = matTransposeStream(&stream);
+        doNotOptimize(transposed);
+        countersStop();
+        benchmarkStop(&bench, i);
+    }
+    s2 = benchmarkStats(&bench);
+    c2 = countersCollect(rep);
+    // --------------------------------
+
+    if (symmetric == -1 || transposed == -1) {
+        printf("Error in reading or writing the files!\n\n");
+        return -1;
+    }
+
+    // Results printing and saving
+    t1 = s1.mean;
+    t2 = s2.mean;
+
+    flops = ((double)n * n / 2 - n) / t1;
+    bandwidth = (double)(2 * (double)n * n * sizeof(double)) / t2;
+
+    printf("Sequential execution: symmetry: %s\n", symmetric ? "true" : "false");
+    printf("checkSymStream:\t\t%.9f seconds\t%10.4g GFLOPS\n", t1, flops * 1e-9);
+    printBenchmarkStats(&s1);
+    if (counters.enabled) printCounterValues(&c1);
+    printf("matTransposeStream:\t%.9f seconds\t%10.4g GB/s\n", t2, bandwidth * 1e-9);
+    printBenchmarkStats(&s2);
+    if (counters.enabled) printCounterValues(&c2);
+    printf("\n");
+
+    if (generated) {
+        printf("Expected symmetry: %s\n", matrix_symmetric ? "true" : "false");
+        testResultsStream(stream.output, n, check_rows, stripe);
+    }
+
+    if (saveResultsMPI(CODE, n, 1, 1, &s1, t1, &s2, t2, &c1, &c2) == -1) {
+        printf("Error in saving results!\n\n");
+    }
+
+    // Files and buffers deallocation
+    close(stream.input);
+    close(stream.output);
+    if (generated) unlink(input_name);
+    if (getOption(argc, argv, "output") == NULL) unlink(output_name);
+
+    for (int k = 0; k < 2; k++) {
+        freeBuffer(stream.slots[k].in);
+        freeBuffer(stream.slots[k].out);
+    }
+    freeBuffer(stripe);
+    freeBuffer(mirror);
+    pthread_mutex_destroy(&stream.mutex);
+    pthread_cond_destroy(&stream.changed);
+    countersClose();
+    allocatorRelease();
+    benchmarkFree(&bench);
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <immintrin.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIMD_SCALAR 0
+#define SIMD_AVX2 1
+#define SIMD_AVX512 2
+
+// Tile kernel transposing a rows x cols tile of src (leading dimension lds) into dst (leading dimension ldd)
+typedef void (*TileKernel)(const double* src, double* dst, int rows, int cols, int lds, int ldd);
+
+// Symmetry kernel comparing a rows x cols tile of a with the transposed cols x rows tile of b, false at the first mismatch
+typedef bool (*SymKernel)(const double* a, const double* b, int rows, int cols, int lda, int ldb, double eps);
+
+// Equality kernel comparing count contiguous elements of a and b, false at the first mismatch
+typedef bool (*EqualKernel)(const double* a, const double* b, int count, double eps);
+
+static inline void transposeTileScalar(const double* src, double* dst, int rows, int cols, int lds, int ldd) {
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            dst[j * ldd + i] = src[i * lds + j];
+        }
+    }
+}
+
+// 4x4 micro-tile transposed in registers: unpack pairs of rows, then swap 128-bit lanes
+__attribute__((target("avx2"))) static inline void transpose4x4RegistersAVX2(__m256d* r) {
+    __m256d t0 = _mm256_unpacklo_pd(r[0], r[1]);  // a0 b0 a2 b2
+    __m256d t1 = _mm256_unpackhi_pd(r[0], r[1]);  // a1 b1 a3 b3
+    __m256d t2 = _mm256_unpacklo_pd(r[2], r[3]);  // c0 d0 c2 d2
+    __m256d t3 = _mm256_unpackhi_pd(r[2], r[3]);  // c1 d1 c3 d3
+
+    r[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+    r[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+    r[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+    r[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+__attribute__((target("avx2"))) static inline void transpose4x4AVX2(const double* src, double* dst, int lds, int ldd) {
+    __m256d r[4];
+    for (int i = 0; i < 4; i++) r[i] = _mm256_loadu_pd(src + i * lds);
+    transpose4x4RegistersAVX2(r);
+    for (int i = 0; i < 4; i++) _mm256_storeu_pd(dst + i * ldd, r[i]);
+}
+
+// 8x8 micro-tile transposed in registers: unpack pairs, then a two-source permute and a 256-bit lane shuffle
+__attribute__((target("avx512f"))) static inline void transpose8x8RegistersAVX512(__m512d* r) {
+    const __m512i lo2 = _mm512_set_epi64(13, 12, 5, 4, 9, 8, 1, 0);
+    const __m512i hi2 = _mm512_set_epi64(15, 14, 7, 6, 11, 10, 3, 2);
+
+    __m512d t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm512_unpacklo_pd(r[i], r[i + 1]);
+        t[i + 1] = _mm512_unpackhi_pd(r[i], r[i + 1]);
+    }
+
+    for (int i = 0; i < 8; i += 4) {
+        u[i] = _mm512_permutex2var_pd(t[i], lo2, t[i + 2]);          // columns 0 and 4
+        u[i + 1] = _mm512_permutex2var_pd(t[i + 1], lo2, t[i + 3]);  // columns 1 and 5
+        u[i + 2] = _mm512_permutex2var_pd(t[i], hi2, t[i + 2]);      // columns 2 and 6
+        u[i + 3] = _mm512_permutex2var_pd(t[i + 1], hi2, t[i + 3]);  // columns 3 and 7
+    }
+
+    for (int i = 0; i < 4; i++) {
+        r[i] = _mm512_shuffle_f64x2(u[i], u[i + 4], 0x44);
+        r[i + 4] = _mm512_shuffle_f64x2(u[i], u[i + 4], 0xEE);
+    }
+}
+
+__attribute__((target("avx512f"))) static inline void transpose8x8AVX512(const double* src, double* dst, int lds, int ldd) {
+    __m512d r[8];
+    for (int i = 0; i < 8; i++) r[i] = _mm512_loadu_pd(src + i * lds);
+    transpose8x8RegistersAVX512(r);
+    for (int i = 0; i < 8; i++) _mm512_storeu_pd(dst + i * ldd, r[i]);
+}
+
+__attribute__((target("avx2"))) static inline void transposeTileAVX2(const double* src, double* dst, int rows, int cols, int lds, int ldd) {
+    int i = 0;
+    for (; i + 4 <= rows; i += 4) {
+        int j = 0;
+        for (; j + 4 <= cols; j += 4) {
+            transpose4x4AVX2(src + i * lds + j, dst + j * ldd + i, lds, ldd);
+        }
+        transposeTileScalar(src + i * lds + j, dst + j * ldd + i, 4, cols - j, lds, ldd);
+    }
+    transposeTileScalar(src + i * lds, dst + i, rows - i, cols, lds, ldd);
+}
+
+__attribute__((target("avx512f"))) static inline void transposeTileAVX512(const double* src, double* dst, int rows, int cols, int lds, int ldd) {
+    int i = 0;
+    for (; i + 8 <= rows; i += 8) {
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            transpose8x8AVX512(src + i * lds + j, dst + j * ldd + i, lds, ldd);
+        }
+        transposeTileScalar(src + i * lds + j, dst + j * ldd + i, 8, cols - j, lds, ldd);
+    }
+    transposeTileScalar(src + i * lds, dst + i, rows - i, cols, lds, ldd);
+}
+
+static inline bool checkTileSymScalar(const double* a, const double* b, int rows, int cols, int lda, int ldb, double eps) {
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (fabs(a[i * lda + j] - b[j * ldb + i]) > eps) return false;
+        }
+    }
+    return true;
+}
+
+// Micro-tiles of b are transposed in registers, then |a - b^T| > eps is tested with a single mask per micro-tile
+__attribute__((target("avx2"))) static inline bool checkTileSymAVX2(const double* a, const double* b, int rows, int cols, int lda, int ldb, double eps) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d tolerance = _mm256_set1_pd(eps);
+
+    int i = 0;
+    for (; i + 4 <= rows; i += 4) {
+        int j = 0;
+        for (; j + 4 <= cols; j += 4) {
+            __m256d r[4];
+            for (int k = 0; k < 4; k++) r[k] = _mm256_loadu_pd(b + (j + k) * ldb + i);
+            transpose4x4RegistersAVX2(r);
+
+            __m256d mismatch = _mm256_setzero_pd();
+            for (int k = 0; k < 4; k++) {
+                __m256d difference = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(a + (i + k) * lda + j), r[k]));
+                mismatch = _mm256_or_pd(mismatch, _mm256_cmp_pd(difference, tolerance, _CMP_GT_OQ));
+            }
+            if (_mm256_movemask_pd(mismatch)) return false;
+        }
+        if (!checkTileSymScalar(a + i * lda + j, b + j * ldb + i, 4, cols - j, lda, ldb, eps)) return false;
+    }
+    return checkTileSymScalar(a + i * lda, b + i, rows - i, cols, lda, ldb, eps);
+}
+
+__attribute__((target("avx512f"))) static inline bool checkTileSymAVX512(const double* a, const double* b, int rows, int cols, int lda, int ldb, double eps) {
+    const __m512d tolerance = _mm512_set1_pd(eps);
+
+    int i = 0;
+    for (; i + 8 <= rows; i += 8) {
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            __m512d r[8];
+            for (int k = 0; k < 8; k++) r[k] = _mm512_loadu_pd(b + (j + k) * ldb + i);
+            transpose8x8RegistersAVX512(r);
+
+            __mmask8 mismatch = 0;
+            for (int k = 0; k < 8; k++) {
+                __m512d difference = _mm512_abs_pd(_mm512_sub_pd(_mm512_loadu_pd(a + (i + k) * lda + j), r[k]));
+                mismatch |= _mm512_cmp_pd_mask(difference, tolerance, _CMP_GT_OQ);
+            }
+            if (mismatch) return false;
+        }
+        if (!checkTileSymScalar(a + i * lda + j, b + j * ldb + i, 8, cols - j, lda, ldb, eps)) return false;
+    }
+    return checkTileSymScalar(a + i * lda, b + i, rows - i, cols, lda, ldb, eps);
+}
+
+static inline bool checkEqualScalar(const double* a, const double* b, int count, double eps) {
+    for (int i = 0; i < count; i++) {
+        if (fabs(a[i] - b[i]) > eps) return false;
+    }
+    return true;
+}
+
+__attribute__((target("avx2"))) static inline bool checkEqualAVX2(const double* a, const double* b, int count, double eps) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d tolerance = _mm256_set1_pd(eps);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d difference = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        if (_mm256_movemask_pd(_mm256_cmp_pd(difference, tolerance, _CMP_GT_OQ))) return false;
+    }
+    return checkEqualScalar(a + i, b + i, count - i, eps);
+}
+
+__attribute__((target("avx512f"))) static inline bool checkEqualAVX512(const double* a, const double* b, int count, double eps) {
+    const __m512d tolerance = _mm512_set1_pd(eps);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512d difference = _mm512_abs_pd(_mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+        if (_mm512_cmp_pd_mask(difference, tolerance, _CMP_GT_OQ)) return false;
+    }
+    return checkEqualScalar(a + i, b + i, count - i, eps);
+}
+
+// Runtime selection through CPUID, PARCO_SIMD=scalar|avx2|avx512 can force a lower level
+static const char* simdName = "scalar";
+
+static inline int simdLevel() {
+    const char* forced = getenv("PARCO_SIMD");
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && (forced == NULL || strcmp(forced, "avx512") == 0)) {
+        simdName = "avx512";
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && (forced == NULL || strcmp(forced, "avx512") == 0 || strcmp(forced, "avx2") == 0)) {
+        simdName = "avx2";
+        return SIMD_AVX2;
+    }
+
+    simdName = "scalar";
+    return SIMD_SCALAR;
+}
+
+static inline TileKernel selectTileKernel() {
+    const TileKernel kernels[] = {transposeTileScalar, transposeTileAVX2, transposeTileAVX512};
+    return kernels[simdLevel()];
+}
+
+static inline SymKernel selectSymKernel() {
+    const SymKernel kernels[] = {checkTileSymScalar, checkTileSymAVX2, checkTileSymAVX512};
+    return kernels[simdLevel()];
+}
+
+static inline EqualKernel selectEqualKernel() {
+    const EqualKernel kernels[] = {checkEqualScalar, checkEqualAVX2, checkEqualAVX512};
+    return kernels[simdLevel()];
+}
+
+#endif
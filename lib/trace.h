@@ -0,0 +1,140 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <mpi.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_FILE "trace.json"
+#define TRACE_SPANS (1 << 16)  // spans kept by every rank, the oldest ones are overwritten when the ring is full
+#define TRACE_SPAN_TEXT 256    // upper bound of the JSON text of a span
+
+// A timed phase of a rank: a collective with the bytes the rank sent or received, or a compute region with none
+typedef struct {
+    const char* name;  // static string, the MPI routine or the kernel function
+    int index;         // iteration of the phase (row of blocks, stage, ...), -1 if not in a loop
+    double start, end;
+    long bytes;
+} TraceSpan;
+
+// Ring buffer of the spans of the rank, written with no locks: a slot is claimed by an atomic increment, so the master
+// thread of a hybrid process does not need to synchronize with its workers
+typedef struct {
+    bool enabled;
+    int rank;
+    const char* file;
+    double origin;  // MPI_Wtime after a barrier, so that the timelines of the ranks start together
+    TraceSpan* spans;
+    unsigned long next;  // spans recorded, the next slot modulo TRACE_SPANS
+} Trace;
+
+static Trace trace = {false};
+
+// Enabled by the trace (or trace=<file>) option, collective over comm
+static inline void traceInit(int argc, char** argv, MPI_Comm comm) {
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "trace") == 0) trace.file = TRACE_FILE;
+        if (strncmp(argv[i], "trace=", 6) == 0) trace.file = argv[i] + 6;
+    }
+    if (trace.file == NULL) return;
+
+    trace.spans = (TraceSpan*)malloc(TRACE_SPANS * sizeof(TraceSpan));
+    trace.enabled = trace.spans != NULL;
+    trace.next = 0;
+    MPI_Comm_rank(comm, &trace.rank);
+    MPI_Barrier(comm);
+    trace.origin = MPI_Wtime();
+}
+
+// Records a span whose times come from MPI_Wtime, a no-op when tracing is disabled
+static inline void traceSpan(const char* name, int index, double start, double end, long bytes) {
+    if (!trace.enabled) return;
+
+    unsigned long slot = __atomic_fetch_add(&trace.next, 1, __ATOMIC_RELAXED) % TRACE_SPANS;
+    TraceSpan* span = &trace.spans[slot];
+    span->name = name;
+    span->index = index;
+    span->start = start - trace.origin;
+    span->end = end - trace.origin;
+    span->bytes = bytes;
+}
+
+// Chrome trace events of the rank, one process per rank in the timeline, oldest span first
+static inline char* traceEvents(int* length) {
+    unsigned long count = trace.next < TRACE_SPANS ? trace.next : TRACE_SPANS;
+    unsigned long first = trace.next - count;
+    char* text = (char*)malloc(TRACE_SPAN_TEXT * (count + 1));
+    int written = sprintf(text, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"rank %d\"}}", trace.rank, trace.rank);
+
+    for (unsigned long i = first; i < trace.next; i++) {
+        const TraceSpan* span = &trace.spans[i % TRACE_SPANS];
+        written += snprintf(text + written, TRACE_SPAN_TEXT,
+                            ",\n{\"name\": \"%.40s\", \"ph\": \"X\", \"pid\": %d, \"tid\": 0, \"ts\": %.3f, \"dur\": %.3f, "
+                            "\"args\": {\"index\": %d, \"bytes\": %ld}}",
+                            span->name, trace.rank, span->start * 1e6, (span->end - span->start) * 1e6, span->index, span->bytes);
+    }
+
+    *length = written;
+    return text;
+}
+
+// Gathers the spans of every rank on rank 0, which writes them as Chrome trace (and Perfetto) JSON; collective over comm
+static inline int traceDump(MPI_Comm comm) {
+    int rank, size, length, result = 0;
+    int *lengths = NULL, *displs = NULL;
+    char *events, *all = NULL;
+
+    if (!trace.enabled) return 0;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    events = traceEvents(&length);
+
+    if (rank == 0) {
+        lengths = (int*)malloc(size * sizeof(int));
+        displs = (int*)malloc(size * sizeof(int));
+    }
+    MPI_Gather(&length, 1, MPI_INT, lengths, 1, MPI_INT, 0, comm);
+
+    if (rank == 0) {
+        long total = 0;
+        for (int r = 0; r < size; r++) {
+            displs[r] = total;
+            total += lengths[r];
+        }
+        all = (char*)malloc(total + 1);
+    }
+    MPI_Gatherv(events, length, MPI_CHAR, all, lengths, displs, MPI_CHAR, 0, comm);
+
+    if (rank == 0) {
+        FILE* f = fopen(trace.file, "w");
+
+        if (f == NULL) {
+            result = -1;
+        } else {
+            fprintf(f, "{\"traceEvents\": [\n");
+            for (int r = 0; r < size; r++) fprintf(f, "%s%.*s", r > 0 ? ",\n" : "", lengths[r], all + displs[r]);
+            fprintf(f, "\n], \"displayTimeUnit\": \"ns\"}\n");
+            fclose(f);
+            printf("Trace of %d processes written to %s\n\n", size, trace.file);
+        }
+
+        free(lengths);
+        free(displs);
+        free(all);
+    }
+
+    free(events);
+
+    return result;
+}
+
+static inline void traceFree() {
+    free(trace.spans);
+    trace.spans = NULL;
+    trace.enabled = false;
+}
+
+#endif
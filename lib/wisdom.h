@@ -0,0 +1,137 @@
+#ifndef WISDOM_H
+#define WISDOM_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_NAME_WISDOM "wisdom"  // overridden by the PARCO_WISDOM environment variable
+#define WISDOM_LINE 512
+#define WISDOM_NAME 128
+
+// Winner of a tuning run: lines "cpu model|code|n|processes|algorithm|block size|seconds" of the wisdom file
+typedef struct {
+    char algorithm[WISDOM_NAME];
+    int block_size;
+    double seconds;
+} Wisdom;
+
+static const int tune_block_sizes[] = {4, 8, 16, 32, 64, 128, 256};
+#define TUNE_BLOCK_SIZES (int)(sizeof(tune_block_sizes) / sizeof(tune_block_sizes[0]))
+
+static inline const char* wisdomFileName() {
+    const char* name = getenv("PARCO_WISDOM");
+    return name != NULL && name[0] != '\0' ? name : FILE_NAME_WISDOM;
+}
+
+// Model name of the CPU, as in the "Model name" line of lscpu saved in results/cpu_specs
+static inline void cpuModel(char* model, size_t size) {
+    char line[WISDOM_LINE];
+    FILE* f = fopen("/proc/cpuinfo", "r");
+
+    snprintf(model, size, "unknown");
+    if (f == NULL) return;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, "model name", 10) == 0 && strchr(line, ':') != NULL) {
+            const char* value = strchr(line, ':') + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            snprintf(model, size, "%.*s", (int)strcspn(value, "\n|"), value);
+            break;
+        }
+    }
+    fclose(f);
+}
+
+// Entry of this CPU for the code and the number of processes with the closest dimension, false if there is none
+static inline bool wisdomLookup(const char* code, int n, int processes, Wisdom* wisdom) {
+    char model[WISDOM_NAME], line[WISDOM_LINE], cpu[WISDOM_NAME], entry_code[WISDOM_NAME], algorithm[WISDOM_NAME];
+    int entry_n, entry_processes, block_size, distance = -1;
+    double seconds;
+    FILE* f = fopen(wisdomFileName(), "r");
+
+    if (f == NULL) return false;
+    cpuModel(model, sizeof(model));
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%127[^|]|%127[^|]|%d|%d|%127[^|]|%d|%lf", cpu, entry_code, &entry_n, &entry_processes, algorithm, &block_size, &seconds) != 7) continue;
+        if (strcmp(cpu, model) != 0 || strcmp(entry_code, code) != 0 || entry_processes != processes) continue;
+
+        int d = abs(entry_n - n);
+        if (distance < 0 || d < distance) {
+            distance = d;
+            snprintf(wisdom->algorithm, sizeof(wisdom->algorithm), "%s", algorithm);
+            wisdom->block_size = block_size;
+            wisdom->seconds = seconds;
+        }
+    }
+    fclose(f);
+
+    return distance >= 0;
+}
+
+// Replaces the entry of this CPU, code, dimension and number of processes, keeping the entries of the other machines
+static inline int wisdomStore(const char* code, int n, int processes, const Wisdom* wisdom) {
+    char model[WISDOM_NAME], line[WISDOM_LINE], key[WISDOM_LINE];
+    char* content = NULL;
+    size_t length = 0;
+    FILE* f = fopen(wisdomFileName(), "r");
+
+    cpuModel(model, sizeof(model));
+    int key_length = snprintf(key, sizeof(key), "%s|%s|%d|%d|", model, code, n, processes);
+
+    if (f != NULL) {
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (strncmp(line, key, key_length) == 0) continue;
+            size_t l = strlen(line);
+            content = (char*)realloc(content, length + l + 1);
+            memcpy(content + length, line, l + 1);
+            length += l;
+        }
+        fclose(f);
+    }
+
+    f = fopen(wisdomFileName(), "w");
+    if (f == NULL) {
+        free(content);
+        return -1;
+    }
+
+    if (content != NULL) fputs(content, f);
+    fprintf(f, "%s%s|%d|%.9f\n", key, wisdom->algorithm, wisdom->block_size, wisdom->seconds);
+    fclose(f);
+    free(content);
+
+    return 0;
+}
+
+// Block size of the wisdom of the code if there is one, otherwise the default one, never larger than n
+static inline int wisdomBlockSize(const char* code, int n, int processes, int default_size) {
+    Wisdom wisdom;
+    int size = wisdomLookup(code, n, processes, &wisdom) && wisdom.block_size > 0 ? wisdom.block_size : default_size;
+    return size < n ? size : n;
+}
+
+// Times every candidate block size not larger than n with run (seconds per call, already reduced over the processes)
+// and returns the fastest one, stored in the wisdom file if store is set
+static inline int tuneBlockSize(const char* code, int n, int processes, bool store, double (*run)(int block_size, void* arg), void* arg) {
+    Wisdom best = {"blocked", 0, -1};
+
+    for (int c = 0; c < TUNE_BLOCK_SIZES && (c == 0 || tune_block_sizes[c] <= n); c++) {
+        int block_size = tune_block_sizes[c] < n ? tune_block_sizes[c] : n;
+        double seconds = run(block_size, arg);
+        if (best.seconds < 0 || seconds < best.seconds) {
+            best.block_size = block_size;
+            best.seconds = seconds;
+        }
+    }
+
+    if (store && wisdomStore(code, n, processes, &best) == -1) {
+        printf("Error in saving wisdom!\n\n");
+    }
+
+    return best.block_size;
+}
+
+#endif
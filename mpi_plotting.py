@@ -4,12 +4,17 @@ import numpy as np
 import pandas as pd
 import matplotlib.pyplot as plt
 
+from results import load_results
+
 pd.options.mode.chained_assignment = None
 
 n = input("Enter the value of n to plot: ")
 
 # Load the data
-data = pd.read_csv("results/results_mpi.csv")
+data = load_results()
+
+# Hybrid runs are compared by the number of cores they use
+data["processes"] = data["processes"] * data["threads"]
 
 # Sort by code and n
 data = data.sort_values(["code", "n", "processes"])
@@ -18,7 +23,7 @@ data = data.sort_values(["code", "n", "processes"])
 filter = pow(2, int(n))
 data = data[data["n"] == filter]
 
-custom_code_order = ["M", "MD", "MC", "MB"]
+custom_code_order = ["M", "MD", "MC", "MB", "MA", "MH", "MS", "MG", "MP", "MR"]
 xticks_values = [1, 2, 4, 8, 16]
 color_map = {code: plt.cm.tab10(i) for i, code in enumerate(data["code"].unique())}
 
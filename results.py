@@ -0,0 +1,40 @@
+# Load results_mpi.csv for the plotting scripts, in both of its layouts
+
+import csv
+import pandas as pd
+
+# Files recorded before the threads, statistics and counters columns, as results/results_mpi.csv
+LEGACY_COLUMNS = ["code", "n", "processes", "time1message", "time1effective", "time2message", "time2effective"]
+
+# Header written by start.sh and start.pbs
+COLUMNS = LEGACY_COLUMNS[:3] + ["threads"] + LEGACY_COLUMNS[3:] + [
+    "time1median", "time1p95", "time1min", "time1stddev",
+    "time2median", "time2p95", "time2min", "time2stddev",
+    "cycles1", "instructions1", "llcmisses1", "dtlbmisses1", "bandwidth1",
+    "cycles2", "instructions2", "llcmisses2", "dtlbmisses2", "bandwidth2",
+]
+
+
+def read_rows(path):
+    """Rows as dictionaries, each one by its own number of fields, so that rows of the current layout appended to a
+    legacy file are read as well; the legacy rows get one thread and no statistics"""
+    rows = []
+    with open(path, newline="") as f:
+        for fields in csv.reader(f):
+            if not fields or fields[0] == "code":
+                continue
+            if len(fields) == len(COLUMNS):
+                rows.append(dict(zip(COLUMNS, fields)))
+            elif len(fields) == len(LEGACY_COLUMNS):
+                rows.append(dict(zip(LEGACY_COLUMNS, fields), threads="1"))
+            else:
+                raise ValueError(f"{path}: row of {len(fields)} fields, expected {len(LEGACY_COLUMNS)} or {len(COLUMNS)}")
+    return rows
+
+
+def load_results(path="results/results_mpi.csv"):
+    data = pd.DataFrame(read_rows(path))
+    for column in data.columns:
+        if column != "code":
+            data[column] = pd.to_numeric(data[column])
+    return data
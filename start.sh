@@ -15,6 +15,9 @@ run_simulations() {
   echo ""; echo "Executing programs..."
   echo ""; echo "sequential.o"; ./sequential.o "$n" "$rep"
   echo ""; echo "sequential_block.o"; ./sequential_block.o "$n" "$rep"
+  echo ""; echo "sequential_block.o inplace"; ./sequential_block.o "$n" "$rep" inplace
+  echo ""; echo "sequential_recursive.o"; ./sequential_recursive.o "$n" "$rep"
+  echo ""; echo "sequential_stream.o"; ./sequential_stream.o "$n" "$rep"
 
   if [[ $procs -eq 0 ]]; then
     for ((p = 1 ; p <= 16 ; p*=2 )); do
@@ -22,17 +25,41 @@ run_simulations() {
       echo ""; echo "mpi_divided.o"; mpirun -np $p ./mpi_divided.o "$n" "$rep"
       echo ""; echo "mpi_custom_datatypes.o"; mpirun -np $p ./mpi_custom_datatypes.o "$n" "$rep"
       echo ""; echo "mpi_block.o"; mpirun -np $p ./mpi_block.o "$n" "$rep"
+      echo ""; echo "mpi_block.o inplace"; mpirun -np $p ./mpi_block.o "$n" "$rep" inplace
+      echo ""; echo "mpi_alltoall.o"; mpirun -np $p ./mpi_alltoall.o "$n" "$rep"
+      echo ""; echo "mpi_shared.o"; mpirun -np $p ./mpi_shared.o "$n" "$rep"
+      echo ""; echo "mpi_grid.o"; mpirun -np $p ./mpi_grid.o "$n" "$rep"
+      echo ""; echo "mpi_pipelined.o"; mpirun -np $p ./mpi_pipelined.o "$n" "$rep"
+      echo ""; echo "mpi_rma.o"; mpirun -np $p ./mpi_rma.o "$n" "$rep"
+      echo ""; echo "mpi_batch.o"; mpirun -np $p ./mpi_batch.o "$n" "$rep"
+      echo ""; echo "mpi_hybrid.o"; OMP_NUM_THREADS=$p mpirun -np 1 -bind-to none ./mpi_hybrid.o "$n" "$rep"
     done
   else
     echo ""; echo "mpi.o"; mpirun -np 1 ./mpi.o "$n" "$rep"
     echo ""; echo "mpi_divided.o"; mpirun -np 1 ./mpi_divided.o "$n" "$rep"
     echo ""; echo "mpi_custom_datatypes.o"; mpirun -np 1 ./mpi_custom_datatypes.o "$n" "$rep"
     echo ""; echo "mpi_block.o"; mpirun -np 1 ./mpi_block.o "$n" "$rep"
+    echo ""; echo "mpi_block.o inplace"; mpirun -np 1 ./mpi_block.o "$n" "$rep" inplace
+    echo ""; echo "mpi_alltoall.o"; mpirun -np 1 ./mpi_alltoall.o "$n" "$rep"
+    echo ""; echo "mpi_shared.o"; mpirun -np 1 ./mpi_shared.o "$n" "$rep"
+    echo ""; echo "mpi_grid.o"; mpirun -np 1 ./mpi_grid.o "$n" "$rep"
+    echo ""; echo "mpi_pipelined.o"; mpirun -np 1 ./mpi_pipelined.o "$n" "$rep"
+    echo ""; echo "mpi_rma.o"; mpirun -np 1 ./mpi_rma.o "$n" "$rep"
+    echo ""; echo "mpi_batch.o"; mpirun -np 1 ./mpi_batch.o "$n" "$rep"
+    echo ""; echo "mpi_hybrid.o"; OMP_NUM_THREADS=1 mpirun -np 1 -bind-to none ./mpi_hybrid.o "$n" "$rep"
 
     echo ""; echo "mpi.o"; mpirun -np $procs ./mpi.o "$n" "$rep"
     echo ""; echo "mpi_divided.o"; mpirun -np $procs ./mpi_divided.o "$n" "$rep"
     echo ""; echo "mpi_custom_datatypes.o"; mpirun -np $procs ./mpi_custom_datatypes.o "$n" "$rep"
     echo ""; echo "mpi_block.o"; mpirun -np $procs ./mpi_block.o "$n" "$rep"
+    echo ""; echo "mpi_block.o inplace"; mpirun -np $procs ./mpi_block.o "$n" "$rep" inplace
+    echo ""; echo "mpi_alltoall.o"; mpirun -np $procs ./mpi_alltoall.o "$n" "$rep"
+    echo ""; echo "mpi_shared.o"; mpirun -np $procs ./mpi_shared.o "$n" "$rep"
+    echo ""; echo "mpi_grid.o"; mpirun -np $procs ./mpi_grid.o "$n" "$rep"
+    echo ""; echo "mpi_pipelined.o"; mpirun -np $procs ./mpi_pipelined.o "$n" "$rep"
+    echo ""; echo "mpi_rma.o"; mpirun -np $procs ./mpi_rma.o "$n" "$rep"
+    echo ""; echo "mpi_batch.o"; mpirun -np $procs ./mpi_batch.o "$n" "$rep"
+    echo ""; echo "mpi_hybrid.o"; OMP_NUM_THREADS=$procs mpirun -np 1 -bind-to none ./mpi_hybrid.o "$n" "$rep"
   fi
 }
 
@@ -99,12 +126,23 @@ cd lib
 echo ""
 echo "Compiling..."
 
-gcc sequential.c -o ../bin/sequential.o -lm
-gcc sequential_block.c -o ../bin/sequential_block.o -lm
-mpicc mpi.c -o ../bin/mpi.o -lm
-mpicc mpi_divided.c -o ../bin/mpi_divided.o -lm
-mpicc mpi_custom_datatypes.c -o ../bin/mpi_custom_datatypes.o -lm
-mpicc mpi_block.c -o ../bin/mpi_block.o -lm
+gcc -O3 -march=native sequential.c -o ../bin/sequential.o -lm
+gcc -O3 -march=native sequential_block.c -o ../bin/sequential_block.o -lm
+gcc -O3 -march=native sequential_recursive.c -o ../bin/sequential_recursive.o -lm
+gcc -O3 -march=native sequential_stream.c -o ../bin/sequential_stream.o -lm -lpthread
+mpicc -O3 -march=native mpi.c -o ../bin/mpi.o -lm
+mpicc -O3 -march=native mpi_divided.c -o ../bin/mpi_divided.o -lm
+mpicc -O3 -march=native mpi_custom_datatypes.c -o ../bin/mpi_custom_datatypes.o -lm
+mpicc -O3 -march=native mpi_block.c -o ../bin/mpi_block.o -lm
+mpicc -O3 -march=native mpi_alltoall.c -o ../bin/mpi_alltoall.o -lm
+mpicc -O3 -march=native -fopenmp mpi_hybrid.c -o ../bin/mpi_hybrid.o -lm
+mpicc -O3 -march=native mpi_shared.c -o ../bin/mpi_shared.o -lm
+mpicc -O3 -march=native mpi_grid.c -o ../bin/mpi_grid.o -lm
+mpicc -O3 -march=native mpi_pipelined.c -o ../bin/mpi_pipelined.o -lm
+mpicc -O3 -march=native mpi_rma.c -o ../bin/mpi_rma.o -lm
+mpicc -O3 -march=native mpi_batch.c -o ../bin/mpi_batch.o -lm
+gcc -O3 -march=native -c parco.c -o ../bin/parco.o && ar rcs ../bin/libparco.a ../bin/parco.o
+mpicc -O3 -march=native -DPARCO_MPI -c parco.c -o ../bin/parco_mpi.o && ar rcs ../bin/libparco_mpi.a ../bin/parco_mpi.o
 
 echo "Compiling executed correctly!"
 
@@ -118,7 +156,7 @@ lscpu > cpu_specs
 
 rm -f results_mpi.csv
 touch results_mpi.csv
-echo "code,n,processes,time1message,time1effective,time2message,time2effective" > results_mpi.csv
+echo "code,n,processes,threads,time1message,time1effective,time2message,time2effective,time1median,time1p95,time1min,time1stddev,time2median,time2p95,time2min,time2stddev,cycles1,instructions1,llcmisses1,dtlbmisses1,bandwidth1,cycles2,instructions2,llcmisses2,dtlbmisses2,bandwidth2" > results_mpi.csv
 
 echo "Done!"
 